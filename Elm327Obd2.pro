@@ -25,35 +25,95 @@ DEFINES += QT_DEPRECATED_WARNINGS
 # You can also select to disable deprecated APIs only up to a certain version of Qt.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
+# Counts every heap allocation, for #ALLOC in the terminal.
+#DEFINES += ELM_COUNT_ALLOCATIONS
+
 
 CONFIG += c++17
 
 SOURCES += \
+        adaptivetimeout.cpp \
+        allocationcounter.cpp \
         connectionmanager.cpp \
+        derivedchannels.cpp \
+        downsample.cpp \
+        dutycycle.cpp \
         elm.cpp \
         elmblesocket.cpp \
+        elmframer.cpp \
+        elminitializer.cpp \
+        elmproxyserver.cpp \
+        elmrecovery.cpp \
+        elmsanitizer.cpp \
+        elmsession.cpp \
+        elmsessionpool.cpp \
         elmtcpsocket.cpp \
-        global.cpp \
+        endpointdiscovery.cpp \
+        fuelconsumption.cpp \
         gps.cpp \
+        heatmapwidget.cpp \
+        keepalive.cpp \
         main.cpp \
         mainwindow.cpp \
         obdgauge.cpp \
         obdscan.cpp \
+        operatingpointmap.cpp \
+        protocoldetector.cpp \
         qcgaugewidget.cpp \
-        settingsmanager.cpp
+        reconnectbackoff.cpp \
+        responsecountlearner.cpp \
+        samplestore.cpp \
+        sessionlogger.cpp \
+        settingsmanager.cpp \
+        stripchart.cpp \
+        tdigest.cpp \
+        tripdetector.cpp \
+        triplogger.cpp \
+        tripstatistics.cpp \
+        vehicleprofile.cpp \
+        wireprofile.cpp
 
 HEADERS += \
+        adaptivetimeout.h \
+        allocationcounter.h \
         connectionmanager.h \
+        derivedchannels.h \
+        downsample.h \
+        dutycycle.h \
         elm.h \
         elmblesocket.h \
+        elmframer.h \
+        elminitializer.h \
+        elmproxyserver.h \
+        elmrecovery.h \
+        elmsanitizer.h \
+        elmsession.h \
+        elmsessionpool.h \
         elmtcpsocket.h \
+        endpointdiscovery.h \
+        fuelconsumption.h \
         global.h \
         gps.h \
+        heatmapwidget.h \
+        keepalive.h \
         mainwindow.h \
         obdgauge.h \
         obdscan.h \
+        operatingpointmap.h \
+        protocoldetector.h \
         qcgaugewidget.h \
-        settingsmanager.h
+        reconnectbackoff.h \
+        responsecountlearner.h \
+        samplestore.h \
+        sessionlogger.h \
+        settingsmanager.h \
+        stripchart.h \
+        tdigest.h \
+        tripdetector.h \
+        triplogger.h \
+        tripstatistics.h \
+        vehicleprofile.h \
+        wireprofile.h
 
 FORMS += \
         mainwindow.ui \
@@ -0,0 +1,109 @@
+#include "adaptivetimeout.h"
+#include "responsecountlearner.h"
+#include "global.h"
+#include <cmath>
+
+namespace
+{
+const int DEFAULT_TIMEOUT = 0x32;       // ELM power-on value, 200 ms
+const int MIN_TIMEOUT = 0x08;           // 32 ms, below this slow gateways drop out
+const int MAX_TIMEOUT = 0xFF;
+const int MIN_SAMPLES = 32;             // latencies before ATST is lowered
+const int UPDATE_EVERY = 16;
+const double MARGIN = 1.25;             // over p99
+const double LATE_RATIO = 0.9;          // of the timeout, counts as late
+}
+
+AdaptiveTimeout::AdaptiveTimeout()
+{
+    reset();
+}
+
+void AdaptiveTimeout::reset()
+{
+    m_latency.clear();
+    m_samples = 0;
+    m_timeout = DEFAULT_TIMEOUT;
+    m_lastAnswered = false;
+}
+
+QString AdaptiveTimeout::record(const QString &command, bool suffixed, bool answeredBefore, const QByteArray &response, qint64 elapsed)
+{
+    // these put ATST back to its power-on value
+    if(command == RESET || command == SET_ALL_DEFAULT || command == SOFT_RESET)
+    {
+        m_timeout = DEFAULT_TIMEOUT;
+        return QString();
+    }
+
+    if(!ResponseCountLearner::isServiceRequest(command))
+        return QString();
+
+    if(response.contains("NO DATA"))
+    {
+        // A pid that answered before timed out right after a good reply:
+        // the limit is too tight. A run of them is just the ecu asleep.
+        bool lastAnswered = m_lastAnswered;
+        m_lastAnswered = false;
+        if(lastAnswered && answeredBefore)
+        {
+            m_latency.clear();
+            m_samples = 0;
+            return setTimeout(m_timeout * 2);
+        }
+        return QString();
+    }
+
+    if(ResponseCountLearner::countResponses(command, response) == 0)
+        return QString();
+
+    m_lastAnswered = true;
+
+    // Without the count the adapter waited the timeout out, not a latency.
+    if(!suffixed)
+        return QString();
+
+    if(elapsed >= m_timeout * 4 * LATE_RATIO)
+    {
+        m_latency.clear();
+        m_samples = 0;
+        return setTimeout(m_timeout + m_timeout / 2);
+    }
+
+    m_latency.add(static_cast<double>(elapsed));
+    m_samples++;
+
+    if(m_samples < MIN_SAMPLES || m_samples % UPDATE_EVERY != 0)
+        return QString();
+
+    int units = static_cast<int>(std::ceil(m_latency.quantile(0.99) * MARGIN / 4.0));
+    if(std::abs(units - m_timeout) < 2)
+        return QString();
+
+    return setTimeout(units);
+}
+
+int AdaptiveTimeout::timeout() const
+{
+    return m_timeout * 4;
+}
+
+double AdaptiveTimeout::latency(double q) const
+{
+    return m_latency.quantile(q);
+}
+
+QString AdaptiveTimeout::setTimeout(int units)
+{
+    units = std::min(MAX_TIMEOUT, std::max(MIN_TIMEOUT, units));
+    if(units == m_timeout)
+        return QString();
+
+    m_timeout = units;
+    return command();
+}
+
+QString AdaptiveTimeout::command() const
+{
+    return QString("ATST%1").arg(m_timeout, 2, 16, QLatin1Char('0')).toUpper();
+}
@@ -0,0 +1,38 @@
+#ifndef ADAPTIVETIMEOUT_H
+#define ADAPTIVETIMEOUT_H
+
+#include <QtCore>
+#include "tdigest.h"
+
+// Fits the ELM response timeout (ATST) to the latency the ecu really shows.
+// Only requests sent with their expected response count are measured: the
+// adapter returns on the last answer, so the round trip is the ecu latency
+// and not the timeout itself. ATST is kept just above its p99; NO DATA or
+// a reply close to the limit raises it again at once.
+class AdaptiveTimeout
+{
+public:
+    AdaptiveTimeout();
+
+    void reset();
+
+    // Feeds one finished request. Returns the ATST command to send before
+    // the next request when the timeout should change, otherwise empty.
+    QString record(const QString &command, bool suffixed, bool answeredBefore, const QByteArray &response, qint64 elapsed);
+
+    // ATST command for the current value, for an adapter that may hold another
+    QString command() const;
+
+    int timeout() const;                // ms
+    double latency(double q) const;     // ms
+
+private:
+    QString setTimeout(int units);
+
+    TDigest m_latency{};
+    int m_samples{0};
+    int m_timeout{};                    // ATST units of 4 ms
+    bool m_lastAnswered{false};
+};
+
+#endif // ADAPTIVETIMEOUT_H
@@ -0,0 +1,135 @@
+#include "allocationcounter.h"
+#include "elm.h"
+#include "elmsanitizer.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifdef ELM_COUNT_ALLOCATIONS
+
+static std::atomic<quint64> s_allocations{0};
+
+void *operator new(std::size_t size)
+{
+    s_allocations.fetch_add(1, std::memory_order_relaxed);
+    if(void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+bool AllocationCounter::enabled()
+{
+    return true;
+}
+
+quint64 AllocationCounter::count()
+{
+    return s_allocations.load(std::memory_order_relaxed);
+}
+
+#else
+
+bool AllocationCounter::enabled()
+{
+    return false;
+}
+
+quint64 AllocationCounter::count()
+{
+    return 0;
+}
+
+#endif
+
+QString AllocationCounter::benchmark(int iterations)
+{
+    // pid replies as the socket hands them over, compact and spaced
+    const QList<QByteArray> replies{
+        QByteArrayLiteral("410C1AF8\r\r>"),
+        QByteArrayLiteral("41 0C 1A F8 \r\r>"),
+        QByteArrayLiteral("410D32\r\r>"),
+        QByteArrayLiteral("41 05 7B \r\r>")};
+
+    ELM *elm = ELM::getInstance();
+    unsigned checksum = 0;
+
+    // as before: to QString, the cleanup chain, split into pairs, stoi
+    QElapsedTimer timer;
+    timer.start();
+    quint64 start = count();
+    for(int i = 0; i < iterations; i++)
+    {
+        for(auto &reply : replies)
+        {
+            QString data = QString::fromLatin1(reply);
+            data.remove("\r");
+            data.remove(">");
+            data = data.trimmed().simplified();
+            data.remove(QRegExp("[^a-zA-Z0-9]+"));
+
+            auto resp = elm->prepareResponseToDecode(data);
+            if(resp.size() > 2 && !resp[0].compare("41", Qt::CaseInsensitive))
+            {
+                checksum += std::stoi(resp[1].toStdString(), nullptr, 16);
+                checksum += std::stoi(resp[2].toStdString(), nullptr, 16);
+            }
+        }
+    }
+    quint64 stringAllocations = count() - start;
+    qint64 stringTime = timer.nsecsElapsed();
+
+    timer.restart();
+    start = count();
+    char buffer[ElmSanitizer::REPLY_CAPACITY];
+    for(int i = 0; i < iterations; i++)
+    {
+        for(auto &reply : replies)
+        {
+            int length = 0;
+            unsigned pid = 0, A = 0, B = 0;
+            ElmSanitizer::sanitize(reply, buffer, ElmSanitizer::REPLY_CAPACITY, length);
+            if(ELM::decodePid(buffer, length, pid, A, B))
+                checksum -= pid + A;
+        }
+    }
+    quint64 byteAllocations = count() - start;
+    qint64 byteTime = timer.nsecsElapsed();
+
+    double samples = static_cast<double>(iterations) * replies.size();
+    QString allocations = enabled()
+            ? QString("%1 / %2 allocations")
+              .arg(stringAllocations / samples, 0, 'f', 1)
+              .arg(byteAllocations / samples, 0, 'f', 1)
+            : QString("allocations not counted, build with ELM_COUNT_ALLOCATIONS");
+
+    return QString("Decode path: QString %1 ns, bytes %2 ns per reply, %3%4")
+            .arg(stringTime / samples, 0, 'f', 0)
+            .arg(byteTime / samples, 0, 'f', 0)
+            .arg(allocations)
+            .arg(checksum == 0 ? QString() : QString(", results differ"));
+}
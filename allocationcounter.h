@@ -0,0 +1,20 @@
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+#include <QtCore>
+
+// Counts heap allocations of the whole program, to show what the reply
+// path costs per sample. The global operator new is only replaced in
+// builds with ELM_COUNT_ALLOCATIONS, otherwise count() stays 0.
+class AllocationCounter
+{
+public:
+    static bool enabled();
+    static quint64 count();
+
+    // Old QString decode path against the byte path over typical pid
+    // replies: allocations and ns per reply, one line of result.
+    static QString benchmark(int iterations);
+};
+
+#endif // ALLOCATIONCOUNTER_H
@@ -1,4 +1,9 @@
 #include "connectionmanager.h"
+#include "global.h"
+#include "tripdetector.h"
+#include "elm.h"
+
+const int KEEPALIVE_TICK = 500;    // ms
 
 ConnectionManager* ConnectionManager::theInstance_ = nullptr;
 
@@ -11,15 +16,17 @@ ConnectionManager *ConnectionManager::getInstance()
     return theInstance_;
 }
 
-ConnectionManager::ConnectionManager(QObject *parent)
+ConnectionManager::ConnectionManager(QObject *parent) :
+    QObject(parent)
 {
-    mElmTcpSocket = new ElmTcpSocket(this);
-    if(mElmTcpSocket)
+    createTcpSocket();
+
+    m_discovery = new EndpointDiscovery(this);
+    if(m_discovery)
     {
-        connect(mElmTcpSocket,&ElmTcpSocket::tcpConnected,this, &ConnectionManager::conConnected);
-        connect(mElmTcpSocket,&ElmTcpSocket::tcpDisconnected,this,&ConnectionManager::conDisconnected);
-        connect(mElmTcpSocket,&ElmTcpSocket::dataReceived,this,&ConnectionManager::conDataReceived);
-        connect(mElmTcpSocket, &ElmTcpSocket::stateChanged, this, &ConnectionManager::conStateChanged);
+        connect(m_discovery, &EndpointDiscovery::found, this, &ConnectionManager::conEndpointFound);
+        connect(m_discovery, &EndpointDiscovery::failed, this, &ConnectionManager::conEndpointFailed);
+        connect(m_discovery, &EndpointDiscovery::stateChanged, this, &ConnectionManager::conStateChanged);
     }
 
     mElmBleSocket = new ElmBleSocket(this);
@@ -34,6 +41,29 @@ ConnectionManager::ConnectionManager(QObject *parent)
 
 }
 
+ConnectionManager::ConnectionManager(const LinkSettings &link, QObject *parent) :
+    QObject(parent),
+    cType(ConnectionType::Wifi),
+    m_ip(link.ip),
+    m_port(link.port),
+    m_linkWireProfile(link.wireProfile)
+{
+    createTcpSocket();
+}
+
+void ConnectionManager::createTcpSocket()
+{
+    mElmTcpSocket = new ElmTcpSocket(this);
+    if(mElmTcpSocket)
+    {
+        connect(mElmTcpSocket,&ElmTcpSocket::tcpConnected,this, &ConnectionManager::conConnected);
+        connect(mElmTcpSocket,&ElmTcpSocket::tcpDisconnected,this,&ConnectionManager::conDisconnected);
+        connect(mElmTcpSocket,&ElmTcpSocket::dataReceived,this,&ConnectionManager::conDataReceived);
+        connect(mElmTcpSocket, &ElmTcpSocket::stateChanged, this, &ConnectionManager::conStateChanged);
+        connect(mElmTcpSocket, &ElmTcpSocket::tcpConnectFailed, this, &ConnectionManager::conConnectFailed);
+    }
+}
+
 bool ConnectionManager::send(const QString &command)
 {
     if(cType == ConnectionType::Wifi)
@@ -54,29 +84,404 @@ bool ConnectionManager::send(const QString &command)
     return false;
 }
 
-QString ConnectionManager::readData(const QString &command)
+QByteArray ConnectionManager::readData(const QString &command, int deadline, bool urgent)
+{
+    if(m_inFlight)
+    {
+        // Called from the event loop of a request that is still waiting:
+        // polls skip their turn, urgent requests stop the adapter and go first.
+        if(!urgent)
+            return QByteArray();
+
+        m_preemptions++;
+        m_recovery.preempted();
+        abortTransport();
+    }
+
+    bool nested = m_inFlight;
+    m_inFlight = true;
+    QByteArray response = exchange(command, deadline, urgent);
+    m_inFlight = nested;
+
+    return response;
+}
+
+bool ConnectionManager::initializeAdapter()
+{
+    if(m_inFlight)
+        return false;
+
+    // init time only, the planners work on text
+    auto request = [this](const QString &command, int deadline) { return QString::fromLatin1(transportRead(command, deadline)); };
+    auto drainInput = [this]() { drain(); };
+
+    m_inFlight = true;
+    m_initializer.setSettings(setupCommands());
+    bool ready = m_initializer.run(request, drainInput, m_adapterProfile);
+
+    // the init sequence read ATI already, checkAdapter has nothing to add
+    QString version = m_initializer.adapterVersion();
+    if(!version.isEmpty())
+    {
+        m_adapterChecked = true;
+        m_responseCounts.setAdapterVersion(version);
+
+        if(version != m_adapterProfile.getAdapterVersion() || m_initializer.adapterDescription() != m_adapterProfile.getAdapterDescription())
+        {
+            m_adapterProfile.setAdapterVersion(version);
+            m_adapterProfile.setAdapterDescription(m_initializer.adapterDescription());
+            m_adapterProfile.saveProfile();
+        }
+    }
+
+    // An earlier session may have left a tuned ATST behind, a reset has not.
+    // A resumed session sends its own tuned value again.
+    if(!m_resuming)
+        m_timeout.reset();
+    if(m_resuming || m_initializer.start() == ElmInitializer::NoReset)
+        transportRead(m_timeout.command(), ElmInitializer::SETTING_DEADLINE);
+
+    // the adapter kept power and its ATSP through a link drop
+    if(!m_resuming || m_initializer.start() != ElmInitializer::NoReset)
+    {
+        // tried with the car this adapter saw last
+        QString protocol = m_protocolDetector.detect(request, drainInput, m_profile.getProtocol());
+
+        // A resumed link is the same car. Otherwise it is known only now,
+        // and the protocol found belongs to its profile.
+        if(!m_resuming)
+        {
+            openVehicle(vehicleKey());
+            // named by its answers, so an ecu is awake on the searched bus
+            if(!m_profile.key().isEmpty())
+                settleProtocol();
+        }
+
+        if(!protocol.isEmpty() && protocol != m_profile.getProtocol())
+        {
+            m_profile.setProtocol(protocol);
+            m_profile.saveProfile();
+        }
+    }
+    // an auto search still starts with the cached protocol
+    m_keepAlive.setProtocol(m_profile.getProtocol());
+    m_inFlight = false;
+
+    return ready;
+}
+
+QByteArray ConnectionManager::exchange(const QString &command, int deadline, bool urgent)
+{
+    if(!m_adapterChecked && ResponseCountLearner::isServiceRequest(command))
+        checkAdapter();
+
+    // backing off from a busy bus, this request is skipped unless the
+    // user waits for it
+    if(!urgent && m_recovery.holdOff(currentTimeMillis()))
+        return QByteArray(HELD_OFF);
+
+    QString request = m_responseCounts.prepare(command);
+    m_keepAlive.activity(currentTimeMillis());
+
+    QByteArray response;
+    qint64 elapsed = 0;
+    for(int attempt = 0; attempt < 2; attempt++)
+    {
+        quint32 preemptions = m_preemptions;
+        qint64 start = currentTimeMillis();
+        response = transportRead(request, deadline);
+        elapsed = currentTimeMillis() - start;
+
+        // stopped by us, not by the bus: no retry
+        if(preemptions != m_preemptions)
+            break;
+
+        if(elapsed >= deadline)
+        {
+            m_recovery.expired();
+            break;
+        }
+
+        auto action = m_recovery.handle(response, currentTimeMillis(), isParked());
+        if(action == ElmRecovery::Drain)
+            drain();
+        else if(action == ElmRecovery::Reinitialize)
+            reinitialize();
+
+        if(action != ElmRecovery::Retry && action != ElmRecovery::Drain)
+            break;
+    }
+
+    int samples = ResponseCountLearner::isServiceRequest(command) ? ResponseCountLearner::countResponses(command, response) : 0;
+    m_wireStatistics.record(request, response, samples);
+
+    if(m_responseCounts.learn(command, request, response))
+    {
+        m_profile.setResponseCounts(m_responseCounts.counts());
+        m_profile.saveProfile();
+    }
+
+    if(samples > 0)
+        settleProtocol();
+
+    QString timeout = m_timeout.record(command, request != command, m_responseCounts.expected(command) > 0, response, elapsed);
+    if(!timeout.isEmpty())
+        transportRead(timeout);
+
+    return response;
+}
+
+void ConnectionManager::keepSessionAlive()
+{
+    // a request in flight is traffic already
+    if(m_inFlight || !m_connected)
+        return;
+
+    auto commands = m_keepAlive.poll(currentTimeMillis(), isParked());
+    if(commands.isEmpty())
+        return;
+
+    // A ping is a request like any other: an error it finds is recovered
+    // from and it is counted on the wire.
+    m_inFlight = true;
+    for(auto &command : commands)
+    {
+        exchange(command, ElmInitializer::SETTING_DEADLINE);
+    }
+    m_inFlight = false;
+}
+
+bool ConnectionManager::isParked() const
+{
+    return this == theInstance_ && TripDetector::getInstance()->isParked();
+}
+
+void ConnectionManager::timerEvent(QTimerEvent *event)
+{
+    if(event->timerId() == m_reconnectTimerId)
+    {
+        killTimer(m_reconnectTimerId);
+        m_reconnectTimerId = 0;
+        connectTransport();
+        return;
+    }
+
+    keepSessionAlive();
+}
+
+void ConnectionManager::scheduleReconnect()
+{
+    if(m_reconnectTimerId)
+        return;
+
+    int delay = m_backoff.next();
+    m_reconnectTimerId = startTimer(delay);
+    emit stateChanged(QString("Link lost, reconnecting in %1 ms (attempt %2)").arg(delay).arg(m_backoff.attempts()));
+}
+
+void ConnectionManager::subscribe()
+{
+    m_keepAlive.subscribe(currentTimeMillis());
+}
+
+void ConnectionManager::unsubscribe()
+{
+    m_keepAlive.unsubscribe(currentTimeMillis());
+}
+
+void ConnectionManager::abortTransport()
+{
+    if(cType == ConnectionType::Wifi)
+    {
+        if(mElmTcpSocket)
+            mElmTcpSocket->abort();
+    }
+    else if(cType == ConnectionType::BlueTooth)
+    {
+        if(mElmBleSocket)
+            mElmBleSocket->abort();
+    }
+}
+
+void ConnectionManager::wakeAdapter()
+{
+    if(m_inFlight || !m_connected)
+        return;
+
+    // A CR would repeat the last command on a chip that is awake after
+    // all, ATLP itself maybe. The stop character of abort() is a space,
+    // ignored by an idle chip, and it waits for the prompt.
+    m_inFlight = true;
+    abortTransport();
+    drain();
+    m_inFlight = false;
+}
+
+void ConnectionManager::drain()
+{
+    if(cType == ConnectionType::Wifi)
+    {
+        if(mElmTcpSocket)
+            mElmTcpSocket->drain();
+    }
+    else if(cType == ConnectionType::BlueTooth)
+    {
+        if(mElmBleSocket)
+            mElmBleSocket->drain();
+    }
+}
+
+void ConnectionManager::reinitialize()
+{
+    // Only the adapter settings, the protocol is found again on the next request.
+    for(auto &command : setupCommands())
+    {
+        transportRead(command);
+    }
+    m_timeout.reset();
+}
+
+QStringList ConnectionManager::setupCommands() const
+{
+    QStringList commands = WireProfile::commands(m_wireProfile);
+    for(auto &command : initializeCommands)
+    {
+        if(command.startsWith("AT") && !commands.contains(command))
+            commands.append(command);
+    }
+    return commands;
+}
+
+void ConnectionManager::checkAdapter()
+{
+    // once per connection, before the first pid request
+    m_adapterChecked = true;
+
+    QString info = QString::fromLatin1(transportRead(GET_ELM_INFO));
+    info.remove(GET_ELM_INFO).remove("\r").remove(">");
+    info = info.trimmed();
+    if(info.isEmpty())
+        return;
+
+    m_responseCounts.setAdapterVersion(info);
+    if(info != m_adapterProfile.getAdapterVersion())
+    {
+        m_adapterProfile.setAdapterVersion(info);
+        m_adapterProfile.saveProfile();
+    }
+}
+
+void ConnectionManager::settleProtocol()
+{
+    if(!m_protocolDetector.isSearching())
+        return;
+
+    // "A6": the search stopped at 6, kept for the next connect
+    QString protocol = ProtocolDetector::protocolNumber(QString::fromLatin1(transportRead(GET_PROTOCOL_NUMBER, ElmInitializer::SETTING_DEADLINE)));
+    if(protocol.isEmpty())
+        return;
+
+    m_protocolDetector.searched(protocol);
+    m_keepAlive.setProtocol(protocol);
+    if(protocol != m_profile.getProtocol())
+    {
+        m_profile.setProtocol(protocol);
+        m_profile.saveProfile();
+    }
+}
+
+QString ConnectionManager::vehicleKey()
+{
+    // The VIN where the car gives one, before 2005 most do not; then the
+    // supported pid map of all its ecus, with the protocol, tells cars apart.
+    // Asked on every fresh connect: a sleeping car costs the short deadline.
+    QString vin = ELM::decodeVin(transportRead(VEHICLE_ID, ElmInitializer::SETTING_DEADLINE));
+    if(!vin.isEmpty())
+        return "vehicle_" + vin;
+
+    // one line per ecu, in whatever order they answer
+    QStringList ecus;
+    for(auto &line : transportRead(PIDS_SUPPORTED20, ElmInitializer::SETTING_DEADLINE).split('\r'))
+    {
+        QByteArray ecu = ElmSanitizer::clean(line);
+        if(ecu.startsWith("4100") && ecu.size() == 12)
+            ecus.append(QString::fromLatin1(ecu.mid(4)));
+    }
+    if(ecus.isEmpty())
+        return QString();
+    ecus.sort();
+
+    return "ecu_" + m_protocolDetector.protocol() + "_" + ecus.join("_");
+}
+
+void ConnectionManager::openVehicle(const QString &key)
+{
+    // not identified, what is learned stays with this connection
+    if(key.isEmpty())
+    {
+        m_profile.close();
+        return;
+    }
+
+    if(key != m_profile.key())
+    {
+        m_profile.open(key);
+        m_responseCounts.setCounts(m_profile.getResponseCounts());
+    }
+
+    if(m_adapterProfile.isOpen() && m_adapterProfile.getLastVehicle() != key)
+    {
+        m_adapterProfile.setLastVehicle(key);
+        m_adapterProfile.saveProfile();
+    }
+}
+
+QString ConnectionManager::adapterKey() const
+{
+    if(cType == ConnectionType::Wifi && !m_ip.isEmpty())
+        return m_ip + "_" + QString::number(m_port);
+    else if(cType == ConnectionType::Wifi)
+        return SettingsManager::getInstance()->getWifiIp() + "_" + QString::number(SettingsManager::getInstance()->getWifiPort());
+    else if(cType == ConnectionType::BlueTooth)
+        return SettingsManager::getInstance()->getBleAddress().toString();
+
+    return QString();
+}
+
+QByteArray ConnectionManager::transportRead(const QString &command, int deadline)
 {
     if(cType == ConnectionType::Wifi)
     {
         if(mElmTcpSocket)
         {
-            return  mElmTcpSocket->readData(command);
+            return  mElmTcpSocket->readData(command, deadline);
         }
     }
     else if(cType == ConnectionType::BlueTooth)
     {
         if(mElmBleSocket)
         {
-            return mElmBleSocket->readData(command);
+            return mElmBleSocket->readData(command, deadline);
         }
     }
 
-    return QString();
+    return QByteArray();
 }
 
 void ConnectionManager::disConnectElm()
 {
-    if(mElmTcpSocket && mElmTcpSocket->isConnected())
+    if(m_discovery)
+        m_discovery->stop();
+
+    // asked for, no reconnect and the next connect starts afresh
+    bool reconnecting = isReconnecting();
+    m_userDisconnect = true;
+    m_session = false;
+    if(m_reconnectTimerId)
+        killTimer(m_reconnectTimerId);
+    m_reconnectTimerId = 0;
+
+    if(mElmTcpSocket && (mElmTcpSocket->isConnected() || reconnecting))
     {
         mElmTcpSocket->disconnectTcp();
     }
@@ -95,21 +500,38 @@ void ConnectionManager::connectElm()
 
 //    disConnectElm();
 
-    m_settingsManager = SettingsManager::getInstance();
+    m_userDisconnect = false;
+    m_session = false;
+    m_discovered = false;
+    m_backoff.reset();
+    connectTransport();
+}
 
+void ConnectionManager::connectTransport()
+{
     if(cType == ConnectionType::Wifi)
     {
         if(mElmTcpSocket)
         {
-            QString ip = m_settingsManager->getWifiIp();
-            quint16 port = m_settingsManager->getWifiPort();
-            mElmTcpSocket->connectTcp(ip, port);
+            QString ip = m_ip;
+            quint16 port = m_port;
+            if(ip.isEmpty())
+            {
+                m_settingsManager = SettingsManager::getInstance();
+                ip = m_settingsManager->getWifiIp();
+                port = m_settingsManager->getWifiPort();
+            }
+            if(ip.isEmpty() || port == 0)
+                conConnectFailed();
+            else
+                mElmTcpSocket->connectTcp(ip, port);
         }
     }
     else if(cType == ConnectionType::BlueTooth)
     {
         if(mElmBleSocket)
         {
+            m_settingsManager = SettingsManager::getInstance();
             auto bleAddress = m_settingsManager->getBleAddress();
             mElmBleSocket->connectBle(bleAddress);
         }
@@ -126,6 +548,16 @@ void ConnectionManager::setCType(const ConnectionType &value)
     }
 }
 
+void ConnectionManager::setPollInterval(int milliseconds)
+{
+    m_pollInterval = milliseconds;
+}
+
+int ConnectionManager::pollInterval() const
+{
+    return m_pollInterval;
+}
+
 void ConnectionManager::startScanBle()
 {
     if(mElmBleSocket)
@@ -147,28 +579,232 @@ ConnectionType ConnectionManager::getCType() const
     return cType;
 }
 
+const AdaptiveTimeout &ConnectionManager::adaptiveTimeout() const
+{
+    return m_timeout;
+}
+
+VehicleProfile &ConnectionManager::vehicleProfile()
+{
+    return m_profile;
+}
+
+const VehicleProfile &ConnectionManager::adapterProfile() const
+{
+    return m_adapterProfile;
+}
+
+const ElmRecovery &ConnectionManager::recovery() const
+{
+    return m_recovery;
+}
+
+const ElmInitializer &ConnectionManager::initializer() const
+{
+    return m_initializer;
+}
+
+const ProtocolDetector &ConnectionManager::protocolDetector() const
+{
+    return m_protocolDetector;
+}
+
+const KeepAlive &ConnectionManager::keepAlive() const
+{
+    return m_keepAlive;
+}
+
+const WireStatistics &ConnectionManager::wireStatistics() const
+{
+    return m_wireStatistics;
+}
+
 bool ConnectionManager::isConnected() const
 {
     return m_connected;
 }
 
+bool ConnectionManager::isInFlight() const
+{
+    return m_inFlight;
+}
+
+bool ConnectionManager::isHoldingOff() const
+{
+    return m_recovery.isHoldingOff(currentTimeMillis());
+}
+
+bool ConnectionManager::isReconnecting() const
+{
+    return m_session && !m_connected && !m_userDisconnect;
+}
+
+qint64 ConnectionManager::lastOutage() const
+{
+    return m_lastOutage;
+}
+
+QString ConnectionManager::rttBenchmark(int rounds)
+{
+    if(cType != ConnectionType::Wifi || !m_connected)
+        return QString("RTT: needs a wifi connection");
+    if(m_inFlight)
+        return QString("RTT: a request is waiting");
+
+    // straight on the socket, without the recovery and timeout learning
+    m_inFlight = true;
+    QString result = mElmTcpSocket->benchmark(ENGINE_RPM, rounds);
+    m_inFlight = false;
+    return result;
+}
+
 void ConnectionManager::conConnected()
 {
+    if(m_session)
+    {
+        resumeSession();
+        return;
+    }
+
+    // a new link may mean another adapter or car
+    m_timeout.reset();
+    m_responseCounts.reset();
+    m_recovery.reset();
+    m_keepAlive.reset();
+    m_wireStatistics.reset();
+    m_wireProfile = WireProfile::fromName(m_ip.isEmpty() ? SettingsManager::getInstance()->getWireProfile() : m_linkWireProfile);
+    m_adapterChecked = false;
+
+    // until initializeAdapter reads the VIN, the car last seen here
+    m_profile.close();
+    m_adapterProfile.close();
+    QString key = adapterKey();
+    if(!key.isEmpty())
+    {
+        m_adapterProfile.open(key);
+        if(!m_adapterProfile.getLastVehicle().isEmpty())
+            m_profile.open(m_adapterProfile.getLastVehicle());
+    }
+    m_responseCounts.setCounts(m_profile.getResponseCounts());
+
     m_connected = true;
+    m_session = true;
+    m_backoff.reset();
+    if(!m_keepAliveTimerId)
+        m_keepAliveTimerId = startTimer(KEEPALIVE_TICK);
     emit connected();
 }
 
+void ConnectionManager::resumeSession()
+{
+    // Same adapter and car as before the drop: what was learned stays, the
+    // adapter gets its settings back only if it lost them.
+    m_keepAlive.reset();
+    m_connected = true;
+    m_resuming = true;
+    if(!resumeAdapter())
+        initializeAdapter();
+    m_resuming = false;
+
+    m_lastOutage = m_linkLost.elapsed();
+    m_backoff.reset();
+    if(!m_keepAliveTimerId)
+        m_keepAliveTimerId = startTimer(KEEPALIVE_TICK);
+    emit resumed();
+}
+
+bool ConnectionManager::resumeAdapter()
+{
+    if(m_inFlight || m_profile.key().isEmpty())
+        return false;
+
+    // An adapter that kept power answers with echo off and still on the
+    // car's protocol; then its setup stands and neither the init nor the
+    // vehicle probes are needed, only the tuned ATST goes again.
+    m_inFlight = true;
+    QString protocol = ProtocolDetector::protocolNumber(QString::fromLatin1(transportRead(GET_PROTOCOL_NUMBER, ElmInitializer::SETTING_DEADLINE)));
+    bool kept = !protocol.isEmpty() && protocol == m_profile.getProtocol();
+    if(kept)
+    {
+        transportRead(m_timeout.command(), ElmInitializer::SETTING_DEADLINE);
+        m_keepAlive.setProtocol(protocol);
+    }
+    m_inFlight = false;
+
+    return kept;
+}
+
 void ConnectionManager::conDisconnected()
 {
+    // sockets report a drop more than once
+    bool wasConnected = m_connected;
     m_connected = false;
+    if(m_keepAliveTimerId)
+        killTimer(m_keepAliveTimerId);
+    m_keepAliveTimerId = 0;
+
+    if(m_session && !m_userDisconnect)
+    {
+        if(wasConnected)
+        {
+            m_linkLost.start();
+            emit disconnected();
+        }
+        scheduleReconnect();
+        return;
+    }
+
     emit disconnected();
 }
 
-void ConnectionManager::conDataReceived(QString data)
+void ConnectionManager::conDataReceived(QByteArray data)
 {
     emit dataReceived(data);
 }
 
+void ConnectionManager::conConnectFailed()
+{
+    // a dropped session keeps trying where it was
+    if(m_session && !m_userDisconnect)
+    {
+        scheduleReconnect();
+        return;
+    }
+
+    // A searched endpoint that fails again is not searched for once more,
+    // a fixed one may sit next to other adapters and is tried again.
+    if(!m_ip.isEmpty())
+    {
+        scheduleReconnect();
+        return;
+    }
+    if(m_discovered || !m_discovery || m_discovery->isRunning())
+        return;
+
+    m_discovery->start(EndpointDiscovery::candidates());
+}
+
+void ConnectionManager::conEndpointFound(QString ip, quint16 port, QString banner)
+{
+    Q_UNUSED(banner)
+
+    // kept for the next start, the search is then not needed
+    m_settingsManager = SettingsManager::getInstance();
+    m_settingsManager->setWifiIp(ip);
+    m_settingsManager->setWifiPort(port);
+    m_settingsManager->saveSettings();
+
+    m_discovered = true;
+    if(mElmTcpSocket)
+        mElmTcpSocket->connectTcp(ip, port);
+}
+
+void ConnectionManager::conEndpointFailed()
+{
+    // nothing answered, the views stop waiting for a link
+    conDisconnected();
+}
+
 void ConnectionManager::conStateChanged(QString state)
 {
     emit stateChanged(state);
@@ -5,50 +5,176 @@
 #include "elmtcpsocket.h"
 #include "elmblesocket.h"
 #include "settingsmanager.h"
+#include "adaptivetimeout.h"
+#include "responsecountlearner.h"
+#include "vehicleprofile.h"
+#include "elmrecovery.h"
+#include "elminitializer.h"
+#include "protocoldetector.h"
+#include "keepalive.h"
+#include "wireprofile.h"
+#include "endpointdiscovery.h"
+#include "reconnectbackoff.h"
 
 enum ConnectionType {BlueTooth, Wifi, Serial, None};
 
+// ms, covers ATSTFF and a protocol search
+const int DEFAULT_DEADLINE = 5000;
+// readData's answer for a request not sent during a backoff
+const char HELD_OFF[] = "HELD OFF";
+
+// A fixed wifi adapter and what its link needs from the settings, read
+// on the GUI thread, so a link on another thread never touches them.
+struct LinkSettings
+{
+    QString ip;
+    quint16 port{0};
+    QString wireProfile;
+};
+
 class ConnectionManager : public QObject
 {
       Q_OBJECT
 
 public:
     explicit ConnectionManager(QObject *parent = nullptr);
+    // The tcp transport only, no bluetooth and no endpoint search; the
+    // endpoint is neither searched for nor saved.
+    explicit ConnectionManager(const LinkSettings &link, QObject *parent = nullptr);
     static ConnectionManager* getInstance();
 
     void connectElm();
     void disConnectElm();
 
     bool send(const QString &);
-    QString readData(const QString &command);
+    // Waits at most deadline ms, then stops the adapter. An urgent request
+    // made while another one waits interrupts that one and goes first; it
+    // is sent during a backoff too.
+    // The reply as the adapter sent it, latin-1 bytes, or HELD_OFF when
+    // the request was not sent.
+    QByteArray readData(const QString &command, int deadline = DEFAULT_DEADLINE, bool urgent = false);
+    // Link setup after connecting, resets the adapter only when needed
+    // and selects the protocol of the vehicle.
+    bool initializeAdapter();
     void setCType(const ConnectionType &value);
+    // ms between two requests of a poll loop on this link
+    void setPollInterval(int milliseconds);
+    int pollInterval() const;
     void startScanBle();
     void stopScanBle();
 
     ConnectionType getCType() const;
+    const AdaptiveTimeout &adaptiveTimeout() const;
+    // the car, named by its VIN once the adapter is initialized
+    VehicleProfile &vehicleProfile();
+    const VehicleProfile &adapterProfile() const;
+    const ElmRecovery &recovery() const;
+    const ElmInitializer &initializer() const;
+    const ProtocolDetector &protocolDetector() const;
+    const KeepAlive &keepAlive() const;
+    const WireStatistics &wireStatistics() const;
+
+    // AT settings of the link: the wire profile, then the rest of the init list
+    QStringList setupCommands() const;
+
+    // Out of ATLP without a request: one byte that is not a CR, then what
+    // the chip prints on waking is dropped.
+    void wakeAdapter();
+
+    // A view that polls holds the bus session open until it unsubscribes.
+    void subscribe();
+    void unsubscribe();
 
     bool isConnected() const;
+    // A request waits for its reply; events run meanwhile, so the link
+    // must not be torn down from them.
+    bool isInFlight() const;
+    // backing off from a busy bus, readData skips its request
+    bool isHoldingOff() const;
+    // The link dropped without the user asking, attempts are running.
+    bool isReconnecting() const;
+    // ms the link was down before the last resume
+    qint64 lastOutage() const;
+    // Round trip of a PID request with Nagle on and off, wifi only. Run
+    // against the emulator for the plain link: python3 -m elm -n 35000
+    // and WifiIp=127.0.0.1 in settings.ini.
+    QString rttBenchmark(int rounds);
 
 private:
     ConnectionType cType{None};
     SettingsManager *m_settingsManager{};
     ElmTcpSocket *mElmTcpSocket{};
     ElmBleSocket *mElmBleSocket{};
+    EndpointDiscovery *m_discovery{};
+    QString m_ip{};
+    quint16 m_port{0};
+    QString m_linkWireProfile{};
+    int m_pollInterval{500};
+    bool m_discovered{false};       // the endpoint came from a search
+    bool m_session{false};          // learned state belongs to this adapter and car
+    bool m_resuming{false};
+    bool m_userDisconnect{false};
+    ReconnectBackoff m_backoff{};
+    int m_reconnectTimerId{0};
+    QElapsedTimer m_linkLost{};
+    qint64 m_lastOutage{0};
     bool m_connected{false};
+    AdaptiveTimeout m_timeout{};
+    ResponseCountLearner m_responseCounts{};
+    VehicleProfile m_profile{};
+    VehicleProfile m_adapterProfile{};
+    bool m_adapterChecked{false};
+    ElmRecovery m_recovery{};
+    ElmInitializer m_initializer{};
+    ProtocolDetector m_protocolDetector{};
+    KeepAlive m_keepAlive{};
+    WireProfile::Mode m_wireProfile{WireProfile::Compact};
+    WireStatistics m_wireStatistics{};
+    int m_keepAliveTimerId{0};
+    bool m_inFlight{false};
+    quint32 m_preemptions{0};
+
+    void createTcpSocket();
+    void connectTransport();
+    void scheduleReconnect();
+    void resumeSession();
+    // The quick way back after a drop, false when a full init is needed.
+    bool resumeAdapter();
+    QByteArray exchange(const QString &command, int deadline, bool urgent = false);
+    void keepSessionAlive();
+    // the trip detector follows the app's own link only
+    bool isParked() const;
+    QByteArray transportRead(const QString &command, int deadline = DEFAULT_DEADLINE);
+    void abortTransport();
+    void drain();
+    void reinitialize();
+    QString adapterKey() const;
+    QString vehicleKey();
+    void settleProtocol();
+    void openVehicle(const QString &key);
+    void checkAdapter();
+
+protected:
+    void timerEvent(QTimerEvent *) override;
 
 signals:
-    void dataReceived(QString);
+    void dataReceived(QByteArray);
     void stateChanged(QString);
     void connected();
+    // back after a drop with the session of before, no init needed
+    void resumed();
     void disconnected();
     void addBleDevice(const QBluetoothAddress&, const QString&);
 
 public slots:
     void conConnected();
     void conDisconnected();
-    void conDataReceived(QString);
+    void conDataReceived(QByteArray);
     void conStateChanged(QString);
     void conAddBleDevice(const QBluetoothAddress&, const QString&);
+    void conConnectFailed();
+    void conEndpointFound(QString, quint16, QString);
+    void conEndpointFailed();
 
 private:
      static ConnectionManager* theInstance_;
@@ -0,0 +1,208 @@
+#include "derivedchannels.h"
+
+namespace
+{
+const double KPA_TO_PSI = 0.1450377377;
+const double STANDARD_PRESSURE = 101.325;      // kPa
+const double FUEL_DENSITY = 740.0;              // g/L, gasoline
+const double FUEL_ENERGY = 43.0;                // MJ/kg
+const double THERMAL_EFFICIENCY = 0.30;
+const double MIN_SPEED = 1.0;                   // km/h, below this L/100km is meaningless
+}
+
+DerivedChannels* DerivedChannels::theInstance_ = nullptr;
+
+DerivedChannels *DerivedChannels::getInstance()
+{
+    if (theInstance_ == nullptr)
+    {
+        theInstance_ = new DerivedChannels();
+    }
+    return theInstance_;
+}
+
+DerivedChannels::DerivedChannels(QObject *parent) :
+    QObject(parent),
+    m_store(SampleStore::getInstance())
+{
+    // PID 33 wins over the gps estimate, which in turn wins over sea level.
+    addNode(CH_AMBIENT_PRESSURE, {CH_BAROMETRIC_PRESSURE, CH_GPS_BAROMETRIC_PRESSURE}, [this](double &out)
+    {
+        if(valid(CH_BAROMETRIC_PRESSURE))
+            out = value(CH_BAROMETRIC_PRESSURE);
+        else if(valid(CH_GPS_BAROMETRIC_PRESSURE))
+            out = value(CH_GPS_BAROMETRIC_PRESSURE);
+        else
+            return false;
+        return true;
+    });
+
+    addNode(CH_BOOST, {CH_MAN_ABSOLUTE_PRESSURE, CH_AMBIENT_PRESSURE}, [this](double &out)
+    {
+        if(!valid(CH_MAN_ABSOLUTE_PRESSURE))
+            return false;
+
+        double ambient = valid(CH_AMBIENT_PRESSURE) ? value(CH_AMBIENT_PRESSURE) : STANDARD_PRESSURE;
+        out = (value(CH_MAN_ABSOLUTE_PRESSURE) - ambient) * KPA_TO_PSI;
+        return true;
+    });
+
+    // The fuel model picks PID 5E, MAF or speed-density from what the ECU supports.
+    addNode(CH_FUEL_FLOW, m_fuel.inputs(), [this](double &out)
+    {
+        return m_fuel.fuelRate([this](int channel, double &value)
+        {
+            if(!valid(channel))
+                return false;
+            value = this->value(channel);
+            return true;
+        }, out);
+    });
+
+    addNode(CH_INSTANT_CONSUMPTION, {CH_FUEL_FLOW, CH_VEHICLE_SPEED}, [this](double &out)
+    {
+        if(!valid(CH_FUEL_FLOW) || !valid(CH_VEHICLE_SPEED) || value(CH_VEHICLE_SPEED) < MIN_SPEED)
+            return false;
+
+        out = value(CH_FUEL_FLOW) / value(CH_VEHICLE_SPEED) * 100.0;
+        return true;
+    });
+
+    addNode(CH_TRIP_FUEL, {CH_FUEL_FLOW, CH_VEHICLE_SPEED}, [this](double &out)
+    {
+        if(!valid(CH_FUEL_FLOW) || !valid(CH_VEHICLE_SPEED))
+            return false;
+
+        qint64 now = std::max(timestamp(CH_FUEL_FLOW), timestamp(CH_VEHICLE_SPEED));
+        m_fuel.integrate(value(CH_FUEL_FLOW), value(CH_VEHICLE_SPEED), now);
+        out = m_fuel.tripFuel();
+        return true;
+    });
+
+    addNode(CH_AVERAGE_CONSUMPTION, {CH_TRIP_FUEL}, [this](double &out)
+    {
+        return m_fuel.tripAverage(out);
+    });
+
+    addNode(CH_WINDOW_CONSUMPTION, {CH_TRIP_FUEL}, [this](double &out)
+    {
+        return m_fuel.windowAverage(out);
+    });
+
+    addNode(CH_ENGINE_POWER, {CH_FUEL_FLOW}, [this](double &out)
+    {
+        // L/h -> kg/h -> MJ/h -> kW, scaled by a typical thermal efficiency
+        out = value(CH_FUEL_FLOW) * FUEL_DENSITY / 1000.0 * FUEL_ENERGY / 3.6 * THERMAL_EFFICIENCY;
+        return true;
+    });
+
+    m_dirty.assign(m_nodes.size(), false);
+}
+
+void DerivedChannels::addNode(int channel, const std::vector<int> &inputs, Compute compute)
+{
+    size_t index = m_nodes.size();
+    m_nodes.push_back(Node{channel, inputs, compute});
+
+    for(int input : inputs)
+    {
+        m_dependents[input].push_back(index);
+    }
+}
+
+void DerivedChannels::update(int channel, double value)
+{
+    update(channel, value, currentTimeMillis());
+}
+
+void DerivedChannels::update(int channel, double value, qint64 timestamp)
+{
+    if(channel < 0 || channel >= CH_COUNT)
+        return;
+
+    store(channel, value, timestamp);
+
+    size_t first = m_nodes.size();
+    markDependents(channel, first);
+
+    // Dependents always come after their inputs, so one forward pass is enough.
+    for(size_t i = first; i < m_nodes.size(); i++)
+    {
+        if(!m_dirty[i])
+            continue;
+
+        m_dirty[i] = false;
+        const Node &node = m_nodes[i];
+
+        double result = 0.0;
+        if(!node.compute(result))
+            continue;
+
+        qint64 newest = 0;
+        for(int input : node.inputs)
+        {
+            if(valid(input))
+                newest = std::max(newest, m_samples[input].timestamp);
+        }
+
+        store(node.channel, result, newest);
+        markDependents(node.channel, first);
+    }
+}
+
+void DerivedChannels::markDependents(int channel, size_t &first)
+{
+    for(size_t index : m_dependents[channel])
+    {
+        m_dirty[index] = true;
+        first = std::min(first, index);
+    }
+}
+
+void DerivedChannels::store(int channel, double value, qint64 timestamp)
+{
+    Sample &sample = m_samples[channel];
+    sample.value = value;
+    sample.timestamp = timestamp;
+    sample.valid = true;
+
+    // The decode path is the store's only producer.
+    m_store->append(channel, timestamp, value);
+    emit channelUpdated(channel, value, timestamp);
+}
+
+bool DerivedChannels::valid(int channel) const
+{
+    return m_samples[channel].valid;
+}
+
+bool DerivedChannels::hasValue(int channel) const
+{
+    if(channel < 0 || channel >= CH_COUNT)
+        return false;
+
+    return m_samples[channel].valid;
+}
+
+double DerivedChannels::value(int channel) const
+{
+    return m_samples[channel].value;
+}
+
+qint64 DerivedChannels::timestamp(int channel) const
+{
+    return m_samples[channel].timestamp;
+}
+
+FuelConsumption &DerivedChannels::fuel()
+{
+    return m_fuel;
+}
+
+void DerivedChannels::resetTrip()
+{
+    m_fuel.resetTrip();
+    m_samples[CH_TRIP_FUEL] = Sample();
+    m_samples[CH_AVERAGE_CONSUMPTION] = Sample();
+    m_samples[CH_WINDOW_CONSUMPTION] = Sample();
+}
@@ -0,0 +1,72 @@
+#ifndef DERIVEDCHANNELS_H
+#define DERIVEDCHANNELS_H
+
+#include <QObject>
+#include <array>
+#include <functional>
+#include <vector>
+#include "global.h"
+#include "fuelconsumption.h"
+#include "samplestore.h"
+
+// Declarative graph of values computed from decoded channels.
+// A node is recomputed only when one of its inputs receives a new sample,
+// and its timestamp is the newest timestamp among those inputs.
+class DerivedChannels : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit DerivedChannels(QObject *parent = nullptr);
+    static DerivedChannels* getInstance();
+
+    void update(int channel, double value, qint64 timestamp);
+    void update(int channel, double value);
+
+    bool hasValue(int channel) const;
+    double value(int channel) const;
+    qint64 timestamp(int channel) const;
+
+    FuelConsumption &fuel();
+    void resetTrip();
+
+signals:
+    void channelUpdated(int channel, double value, qint64 timestamp);
+
+private:
+    // Returns false when the node can not be computed from its current inputs.
+    typedef std::function<bool(double &)> Compute;
+
+    struct Sample
+    {
+        double value{0.0};
+        qint64 timestamp{0};
+        bool valid{false};
+    };
+
+    struct Node
+    {
+        int channel;
+        std::vector<int> inputs;
+        Compute compute;
+    };
+
+    void addNode(int channel, const std::vector<int> &inputs, Compute compute);
+    void markDependents(int channel, size_t &first);
+    void store(int channel, double value, qint64 timestamp);
+    bool valid(int channel) const;
+
+    std::array<Sample, CH_COUNT> m_samples{};
+    // Nodes are kept in topological order: a node may only read raw channels
+    // or channels of nodes added before it.
+    std::vector<Node> m_nodes{};
+    std::array<std::vector<size_t>, CH_COUNT> m_dependents{};
+    std::vector<bool> m_dirty{};
+
+    FuelConsumption m_fuel{};
+    SampleStore *m_store{};
+
+    static DerivedChannels* theInstance_;
+};
+
+#endif // DERIVEDCHANNELS_H
@@ -0,0 +1,72 @@
+#include "downsample.h"
+
+std::vector<Sample> Downsample::lttb(const std::vector<Sample> &samples, size_t threshold)
+{
+    return lttb(samples.size(), [&samples](size_t i) { return samples[i]; }, threshold);
+}
+
+bool Downsample::covers(const SampleRing *ring, qint64 from)
+{
+    // Until the ring wraps it holds everything ever written.
+    if(ring->first() == 0)
+        return true;
+
+    Sample oldest;
+    return ring->at(ring->first() + 1, oldest) && oldest.timestamp <= from;
+}
+
+void Downsample::copyRange(const SampleRing *ring, qint64 from, qint64 to, std::vector<Sample> &out)
+{
+    quint64 begin = ring->lowerBound(from);
+    quint64 end = ring->lowerBound(to + 1);
+
+    out.reserve(out.size() + (end > begin ? end - begin : 0));
+    ring->forEach(begin, end, [&out](quint64, const Sample &sample)
+    {
+        out.push_back(sample);
+    });
+}
+
+std::vector<Sample> Downsample::window(const SampleStore *store, int channel, qint64 from, qint64 to, int pixels)
+{
+    std::vector<Sample> result;
+
+    const SampleRing *ring = store->ring(channel);
+    const MinMaxPyramid *pyramid = store->pyramid(channel);
+    if(!ring || !pyramid || pixels <= 0 || to <= from)
+        return result;
+
+    qint64 span = to - from;
+    size_t target = static_cast<size_t>(pixels);
+
+    // Below one pyramid bucket per two columns the raw samples are the better source.
+    if(covers(ring, from) && span / pyramid->bucketDuration(0) < pixels / 2)
+    {
+        copyRange(ring, from, to, result);
+        if(result.size() > 2 * target)
+            result = lttb(result, target);
+        return result;
+    }
+
+    for(int level = 0; level < MinMaxPyramid::LEVELS; level++)
+    {
+        const SampleRing *envelope = pyramid->level(level);
+        bool last = level == MinMaxPyramid::LEVELS - 1;
+
+        if(!last && (span / pyramid->bucketDuration(level) > pixels || !covers(envelope, from)))
+            continue;
+
+        copyRange(envelope, from, to, result);
+        break;
+    }
+
+    // The open buckets are not published yet, finish with the newest raw sample.
+    Sample newest;
+    if(ring->latest(newest) && newest.timestamp <= to &&
+            (result.empty() || newest.timestamp > result.back().timestamp))
+    {
+        result.push_back(newest);
+    }
+
+    return result;
+}
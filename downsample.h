@@ -0,0 +1,92 @@
+#ifndef DOWNSAMPLE_H
+#define DOWNSAMPLE_H
+
+#include <cmath>
+#include <vector>
+#include "samplestore.h"
+
+// Reduces a channel history to what can actually be drawn or exported.
+class Downsample
+{
+public:
+    // Largest-Triangle-Three-Buckets over count samples read through at(i).
+    // Keeps the first and last sample and the visually dominant one per bucket.
+    template<class Access>
+    static std::vector<Sample> lttb(size_t count, Access at, size_t threshold)
+    {
+        std::vector<Sample> result;
+
+        if(threshold >= count || threshold < 3)
+        {
+            result.reserve(count);
+            for(size_t i = 0; i < count; i++)
+                result.push_back(at(i));
+            return result;
+        }
+
+        result.reserve(threshold);
+
+        // x relative to the first sample keeps the areas well inside double precision
+        const Sample origin = at(0);
+        const double every = static_cast<double>(count - 2) / (threshold - 2);
+
+        Sample a = origin;
+        result.push_back(a);
+
+        for(size_t i = 0; i < threshold - 2; i++)
+        {
+            size_t averageStart = static_cast<size_t>((i + 1) * every) + 1;
+            size_t averageEnd = std::min(static_cast<size_t>((i + 2) * every) + 1, count);
+            averageEnd = std::max(averageEnd, std::min(averageStart + 1, count));
+
+            double averageX = 0.0, averageY = 0.0;
+            for(size_t j = averageStart; j < averageEnd; j++)
+            {
+                Sample sample = at(j);
+                averageX += sample.timestamp - origin.timestamp;
+                averageY += sample.value;
+            }
+            averageX /= (averageEnd - averageStart);
+            averageY /= (averageEnd - averageStart);
+
+            size_t rangeStart = static_cast<size_t>(i * every) + 1;
+            size_t rangeEnd = static_cast<size_t>((i + 1) * every) + 1;
+
+            double ax = a.timestamp - origin.timestamp;
+            double maxArea = -1.0;
+            Sample selected = at(rangeStart);
+
+            for(size_t j = rangeStart; j < rangeEnd; j++)
+            {
+                Sample sample = at(j);
+                double x = sample.timestamp - origin.timestamp;
+                double area = std::abs((ax - averageX) * (sample.value - a.value) - (ax - x) * (averageY - a.value));
+                if(area > maxArea)
+                {
+                    maxArea = area;
+                    selected = sample;
+                }
+            }
+
+            result.push_back(selected);
+            a = selected;
+        }
+
+        result.push_back(at(count - 1));
+        return result;
+    }
+
+    static std::vector<Sample> lttb(const std::vector<Sample> &samples, size_t threshold);
+
+    // About `pixels` points covering [from, to] of one channel. Short windows
+    // come from the raw ring (LTTB when there are too many samples), long
+    // ones from the finest min/max pyramid level that fits, so the cost
+    // follows the pixel count rather than the sample count.
+    static std::vector<Sample> window(const SampleStore *store, int channel, qint64 from, qint64 to, int pixels);
+
+private:
+    static bool covers(const SampleRing *ring, qint64 from);
+    static void copyRange(const SampleRing *ring, qint64 from, qint64 to, std::vector<Sample> &out);
+};
+
+#endif // DOWNSAMPLE_H
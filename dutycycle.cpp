@@ -0,0 +1,75 @@
+#include "dutycycle.h"
+#include "connectionmanager.h"
+
+DutyCycle::DutyCycle(TripDetector *detector, ConnectionManager *connection) :
+    m_detector(detector),
+    m_connection(connection)
+{
+}
+
+void DutyCycle::setProbeInterval(int milliseconds)
+{
+    m_probeInterval = milliseconds;
+}
+
+bool DutyCycle::isIdle() const
+{
+    return m_detector->isIdle();
+}
+
+int DutyCycle::timerInterval() const
+{
+    int interval = m_connection->pollInterval();
+    return isIdle() ? std::max(interval, m_probeInterval) : interval;
+}
+
+void DutyCycle::probe(const Request &request)
+{
+    // ATRV answers even with the ecu asleep, a charging voltage already
+    // tells the engine started; rpm confirms it or keeps the ecu awake count.
+    // Waking reads it already.
+    if(m_lowPower)
+        wake(request);
+    else
+        request(VOLTAGE);
+    if(isIdle())
+        request(ENGINE_RPM);
+
+    if(!m_detector->isParked() || m_lowPowerSupport == NotSupported)
+        return;
+
+    // v1.4 and later sleep about a second after the OK; older chips and
+    // many clones answer "?" and are not asked again. No answer at all
+    // proves nothing, the next probe asks again.
+    auto response = request(LOW_POWER);
+    if(response.contains("OK"))
+    {
+        m_lowPowerSupport = Supported;
+        m_lowPower = true;
+    }
+    else if(response.contains('?'))
+    {
+        m_lowPowerSupport = NotSupported;
+    }
+}
+
+void DutyCycle::wake(const Request &request)
+{
+    if(!m_lowPower)
+        return;
+
+    // Any character wakes the chip; sent raw, it is no request to the
+    // wire statistics or the timeout. Some chips come back as after ATWS
+    // with default settings, others keep ours. Echo off is one of them:
+    // an ATRV echoed or unanswered means the link setup is sent again.
+    m_connection->wakeAdapter();
+    auto voltage = request(VOLTAGE);
+    if(voltage.isEmpty() || voltage.contains(VOLTAGE.toLatin1()))
+    {
+        for(auto &command : m_connection->setupCommands())
+        {
+            request(command);
+        }
+    }
+    m_lowPower = false;
+}
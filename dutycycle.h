@@ -0,0 +1,46 @@
+#ifndef DUTYCYCLE_H
+#define DUTYCYCLE_H
+
+#include <functional>
+#include "global.h"
+#include "tripdetector.h"
+
+class ConnectionManager;
+
+// Idle duty cycle of a poll loop. With the engine off every request only
+// runs into the ecu timeout, so the loop drops to one probe every few
+// seconds and lets the adapter sleep in ATLP between probes where it
+// supports that. A probe that sees the engine running ends the idle mode.
+class DutyCycle
+{
+public:
+    // Sends one command and returns the raw answer of the adapter.
+    typedef std::function<QByteArray(const QString &)> Request;
+
+    DutyCycle(TripDetector *detector, ConnectionManager *connection);
+
+    void setProbeInterval(int milliseconds);
+    bool isIdle() const;
+    // Timer period for the poll loop in the current mode.
+    int timerInterval() const;
+
+    void probe(const Request &request);
+    // Brings the adapter out of low power, needed before full rate polling.
+    void wake(const Request &request);
+
+private:
+    enum Support
+    {
+        SupportUnknown,
+        Supported,
+        NotSupported
+    };
+
+    TripDetector *m_detector{};
+    ConnectionManager *m_connection{};
+    int m_probeInterval{5000};
+    bool m_lowPower{false};
+    Support m_lowPowerSupport{SupportUnknown};
+};
+
+#endif // DUTYCYCLE_H
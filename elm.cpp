@@ -19,12 +19,13 @@ ELM *ELM::getInstance()
 {
     if (theInstance_ == nullptr)
     {
-        theInstance_ = new ELM();
+        theInstance_ = new ELM(ConnectionManager::getInstance());
     }
     return theInstance_;
 }
 
-ELM::ELM()
+ELM::ELM(ConnectionManager *connection) :
+    m_connection(connection)
 {
 }
 
@@ -43,6 +44,100 @@ std::vector<QString> ELM::prepareResponseToDecode(const QString &response_str)
     return result;
 }
 
+static inline int hexValue(char c)
+{
+    if(c >= '0' && c <= '9')
+        return c - '0';
+    if(c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+static inline bool hexByte(const char *data, unsigned &value)
+{
+    int high = hexValue(data[0]);
+    int low = hexValue(data[1]);
+    if(high < 0 || low < 0)
+        return false;
+
+    value = static_cast<unsigned>(high * 16 + low);
+    return true;
+}
+
+bool ELM::decodePid(const char *data, int size, unsigned &pid, unsigned &A, unsigned &B)
+{
+    if(size < 6 || data[0] != '4' || data[1] != '1')
+        return false;
+
+    if(!hexByte(data + 2, pid) || !hexByte(data + 4, A))
+        return false;
+
+    B = 0;
+    if(size >= 8 && !hexByte(data + 6, B))
+        B = 0;
+
+    return true;
+}
+
+bool ELM::decodeVoltage(const char *data, int size, double &volts)
+{
+    if(size < 3 || data[size - 1] != 'V')
+        return false;
+
+    int tenths = 0;
+    for(int i = 0; i < size - 1; i++)
+    {
+        if(data[i] < '0' || data[i] > '9')
+            return false;
+        tenths = tenths * 10 + (data[i] - '0');
+    }
+
+    volts = tenths / 10.0;
+    return true;
+}
+
+QString ELM::decodeVin(const QByteArray &reply)
+{
+    QByteArray data;
+    for(auto line : reply.split('\r'))
+    {
+        line.replace(" ", "");
+        // CAN frames are numbered "0:", "1:", the first line is the byte count
+        if(line.size() > 2 && line.at(1) == ':')
+            line.remove(0, 2);
+        else if(line.size() <= 3)
+            continue;
+
+        // SEARCHING..., NO DATA and the prompt carry no VIN bytes
+        bool hex = true;
+        for(char c : line)
+        {
+            hex = hex && hexValue(c) >= 0;
+        }
+        if(!hex)
+            continue;
+
+        // "4902" and the message count or line number, then VIN bytes
+        if(line.startsWith("4902"))
+            line.remove(0, 6);
+        data += line;
+    }
+
+    QString vin;
+    for(int i = 0; i + 1 < data.size(); i += 2)
+    {
+        unsigned value = 0;
+        hexByte(data.constData() + i, value);
+
+        // ISO lines pad the first one with zeros
+        char c = static_cast<char>(value);
+        if((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z'))
+            vin.append(QChar(c));
+    }
+
+    return vin.size() >= 17 ? vin.right(17) : QString();
+}
+
 std::vector<QString> ELM::decodeDTC(const std::vector<QString> &hex_vals)
 {
     std::vector<QString> dtc_codes;
@@ -90,6 +185,18 @@ void ELM::resetPids()
     for (int h = 0; h < 256; h++) {
         available_pids[h] = false;
     }
+    available_pids_checked = false;
+}
+
+bool ELM::isPidAvailable(quint8 pid) const
+{
+    // bit n of the 0100 bitmap is pid n+1
+    return pid > 0 && available_pids[pid - 1];
+}
+
+bool ELM::pidsChecked() const
+{
+    return available_pids_checked;
 }
 
 QString ELM::get_available_pids()
@@ -191,12 +298,12 @@ void ELM::update_available_pidset(quint8 set)
 
     QString cmd{};
 
-    while(cmd.isEmpty())
+    // a dropped link ends the wait, the defaults below are taken
+    while(cmd.isEmpty() && m_connection->isConnected())
     {
-        cmd = ConnectionManager::getInstance()->readData(cmd1).toUpper();
-        cmd = cmd.trimmed().simplified();
-        cmd.remove(QRegExp("[\\n\\t\\r]"));
-        cmd.remove(QRegExp("[^a-zA-Z0-9]+"));
+        auto reply = m_connection->readData(cmd1);
+        if(reply != HELD_OFF)
+            cmd = QString::fromLatin1(ElmSanitizer::clean(reply));
     }
 
     if(!cmd.startsWith(QString("41")))
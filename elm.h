@@ -3,18 +3,31 @@
 #include <QtCore>
 #include <string>
 #include "connectionmanager.h"
+#include "elmsanitizer.h"
 
 class ELM
 {
 public:
-    ELM();
+    // Requests of get_available_pids go over connection.
+    explicit ELM(ConnectionManager *connection);
     static ELM* getInstance();
     QString get_available_pids();
     void resetPids();
+    bool isPidAvailable(quint8 pid) const;
+    bool pidsChecked() const;
     std::vector<QString> decodeDTC(const std::vector<QString> &hex_vals);
     std::pair<int,bool> decodeNumberOfDtc(const std::vector<QString> &hex_vals);
     std::vector<QString> prepareResponseToDecode(const QString &response_str);
 
+    // Decoders on sanitized replies, straight from the bytes.
+    // "41PPAA[BB]": pid and data bytes, B is 0 for one byte pids.
+    static bool decodePid(const char *data, int size, unsigned &pid, unsigned &A, unsigned &B);
+    // ATRV "124V": volts with the last digit as tenths.
+    static bool decodeVoltage(const char *data, int size, double &volts);
+    // 0902 as the adapter sent it, CAN frames or ISO lines; empty when
+    // no 17 character VIN is in it.
+    static QString decodeVin(const QByteArray &reply);
+
 private:
     bool available_pids[256];
     bool available_pids_checked = false;
@@ -25,6 +38,7 @@ private:
                                       {'8',QString("B0")},{'9',QString("B1")},{'A',QString("B2")},{'B',QString("B3")},
                                       {'C',QString("U0")},{'D',QString("U1")},{'E',QString("U2")},{'F',QString("U3")}
                                      };
+    ConnectionManager *m_connection{};
     static ELM* theInstance_;
 
 };
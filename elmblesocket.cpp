@@ -1,8 +1,11 @@
 #include "elmblesocket.h"
+#include <QElapsedTimer>
+#include <QScopedValueRollback>
 #include <QDebug>
 
 
 ElmBleSocket::ElmBleSocket(QObject *parent):
+    QThread(parent),
     localDevice(new QBluetoothLocalDevice)
 {
 
@@ -185,63 +188,92 @@ void ElmBleSocket::scanFinished()
     }
 }
 
-QString ElmBleSocket::readData(const QString &command)
+void ElmBleSocket::drain()
 {
-   QString strData{};
+    QScopedValueRollback<bool> syncRead(m_syncRead, true);
+
+    // whatever the adapter still sends belongs to no request
+    int timeout(2);
+    while (timeout)
+    {
+        if(socket->bytesAvailable() > 0)
+            socket->readAll();
+        msleep(20);
+        timeout--;
+        QCoreApplication::processEvents(QEventLoop::AllEvents);
+    }
+    m_framer.clear();
+}
+
+QByteArray ElmBleSocket::readData(const QString &command, int deadline)
+{
+    // A request started from the event loop below supersedes this one.
+    quint32 generation = ++m_generation;
+    QScopedValueRollback<bool> syncRead(m_syncRead, true);
+
+    // left over from an earlier reply, not part of this one
+    m_framer.clear();
 
     if(sendAsync(command))
     {
-        int timeout(3);
-        while (timeout && !socket->bytesAvailable())
-        {
-            msleep(100);
-            timeout--;
-            QCoreApplication::processEvents(QEventLoop::AllEvents);
-        }
+        QElapsedTimer timer;
+        timer.start();
 
-        while(socket->bytesAvailable() > 0)
+        while(generation == m_generation)
         {
-            QByteArray data;
-            data.reserve(static_cast<qint16>(socket->bytesAvailable()));
-            data = socket->readAll();
-            byteblock += data;
+            // the link dropped, nothing more will come for this request
+            if(!m_connected)
+                return QByteArray();
 
-            strData = QString::fromStdString(byteblock.toStdString());
-
-            if(strData.contains("\r"))
+            if(timer.elapsed() >= deadline)
             {
-                byteblock.clear();
+                abort();
+                return QByteArrayLiteral("STOPPED");
+            }
 
-                if(!strData.isEmpty())
-                {
-                    emit dataReceived(strData);
-                    return strData;
-                }
+            // the reply is complete with the prompt, not the first line end
+            QByteArray reply;
+            if(fill() && m_framer.takeReply(reply))
+            {
+                emit dataReceived(reply);
+                return reply;
             }
+
+            msleep(20);
+            QCoreApplication::processEvents(QEventLoop::AllEvents);
         }
+
+        // preempted, the newer request already stopped the adapter
+        return QByteArrayLiteral("STOPPED");
     }
-    return strData;
+    return QByteArray();
+}
+
+void ElmBleSocket::abort()
+{
+    QScopedValueRollback<bool> syncRead(m_syncRead, true);
+
+    // Any character stops the ELM, a space is ignored if it was idle already.
+    socket->write(" ");
+
+    QElapsedTimer timer;
+    timer.start();
+    QByteArray answer;
+    while(timer.elapsed() < 300 && !answer.contains('>'))
+    {
+        if(socket->bytesAvailable() > 0)
+            answer += socket->readAll();
+        msleep(20);
+        QCoreApplication::processEvents(QEventLoop::AllEvents);
+    }
+    m_framer.clear();
 }
 
 bool ElmBleSocket::sendAsync(const QString &command)
 {
     if(socket->isOpen())
     {
-        QByteArray dataToSend = command.toUtf8();
-
-        if (command.isEmpty())
-        {
-            // If toWrite is empty then just send a CR char.
-            dataToSend += ('\r');
-        }
-        else
-        {
-            // Check for CR at end.
-            if (dataToSend[dataToSend.size()] != '\r')
-                dataToSend += '\r';
-        }
-
-        return socket->write(dataToSend);
+        return socket->write(encode(command));
     }
     else
         return false;
@@ -251,48 +283,61 @@ bool ElmBleSocket::send(const QString &string)
 {
     if(socket->isOpen())
     {
-        connect(socket,&QBluetoothSocket::readyRead,this,&ElmBleSocket::readyRead);
-
-        QByteArray dataToSend = string.toUtf8();
-
-        if (string.isEmpty())
-        {
-            // If toWrite is empty then just send a CR char.
-            dataToSend += ('\r');
-        }
-        else
-        {
-            // Check for CR at end.
-            if (dataToSend[dataToSend.size()] != '\r')
-                dataToSend += '\r';
-        }
-
-        socket->write(dataToSend);
+        socket->write(encode(string));
         return true;
     }
     else
         return false;
 }
 
+const QByteArray &ElmBleSocket::encode(const QString &command)
+{
+    // Commands are plain ASCII. Written over the last one, the buffer
+    // keeps its capacity and a request costs no allocation.
+    int size = command.size();
+    bool terminated = size > 0 && command.at(size - 1) == QChar('\r');
+
+    m_sendBuffer.resize(terminated ? size : size + 1);
+    for(int i = 0; i < size; i++)
+    {
+        m_sendBuffer[i] = command.at(i).toLatin1();
+    }
+    m_sendBuffer[m_sendBuffer.size() - 1] = '\r';
+
+    return m_sendBuffer;
+}
+
+bool ElmBleSocket::fill()
+{
+    // straight into the framer, no buffer of our own in between
+    bool read = false;
+    while(socket->bytesAvailable() > 0)
+    {
+        int space = 0;
+        char *buffer = m_framer.writeBuffer(space);
+        qint64 count = socket->read(buffer, space);
+        if(count <= 0)
+            break;
+
+        m_framer.commit(static_cast<int>(count));
+        read = true;
+    }
+    return read;
+}
+
 void ElmBleSocket::readyRead()
 {
-    QString strData{};
-    QByteArray data = socket->readAll();
-    byteblock += data;
+    // Connected for the whole session: a waiting readData takes its
+    // reply itself, the slot only sees answers to send().
+    if(m_syncRead)
+        return;
 
-    strData = QString::fromStdString(byteblock.toStdString());
+    fill();
 
-    if(strData.contains("\r"))
+    QByteArray reply;
+    while(m_framer.takeReply(reply))
     {
-        if(!strData.isEmpty())
-        {
-            byteblock.clear();
-            if(!strData.isEmpty())
-            {
-                disconnect(socket,&QBluetoothSocket::readyRead,this,&ElmBleSocket::readyRead);
-                emit dataReceived(strData);
-            }
-        }
+        emit dataReceived(reply);
     }
 }
 
@@ -13,6 +13,7 @@
 #include <qtconcurrentrun.h>
 #include <QThread>
 #include <QBluetoothDeviceDiscoveryAgent>
+#include "elmframer.h"
 
 QT_FORWARD_DECLARE_CLASS(QBluetoothDeviceDiscoveryAgent)
 QT_FORWARD_DECLARE_CLASS(QBluetoothDeviceInfo)
@@ -30,7 +31,9 @@ public:
     void stopScan();
     bool sendAsync(const QString &command);
     bool send(const QString &);
-    QString readData(const QString &command);
+    QByteArray readData(const QString &command, int deadline);
+    void drain();
+    void abort();
     void connectBle(const QBluetoothAddress &);
     void disconnectBle();
     bool isConnected();
@@ -50,7 +53,7 @@ private slots:
 
 
 signals:
-    void dataReceived(QString);
+    void dataReceived(QByteArray);
     void stateChanged(QString);
     void bleConnected();
     void bleDisconnected();
@@ -62,9 +65,14 @@ private:
     QBluetoothSocket* socket{};
     QBluetoothLocalDevice *localDevice{};
     QBluetoothDeviceDiscoveryAgent *discoveryAgent{};
-    QByteArray byteblock{};
+    ElmFramer m_framer{};
+    QByteArray m_sendBuffer{};
     bool m_connected{false};
+    quint32 m_generation{0};
+    bool m_syncRead{false};         // readData or drain reads, not readyRead
 
+    const QByteArray &encode(const QString &command);
+    bool fill();
     void scanBle();
     void handleDiscoveryTimeout();
     QTimer m_scanTimer{};
@@ -0,0 +1,219 @@
+#include "elmframer.h"
+#include "allocationcounter.h"
+#include <cstring>
+
+int ElmFramer::Frame::length() const
+{
+    return size + wrappedSize;
+}
+
+int ElmFramer::Frame::copy(char *out, int capacity) const
+{
+    int first = std::min(size, capacity);
+    std::memcpy(out, data, first);
+
+    int second = std::min(wrappedSize, capacity - first);
+    if(second > 0)
+        std::memcpy(out + first, wrapped, second);
+
+    return first + std::max(second, 0);
+}
+
+void ElmFramer::Frame::appendTo(QByteArray &out) const
+{
+    out.append(data, size);
+    if(wrappedSize > 0)
+        out.append(wrapped, wrappedSize);
+}
+
+ElmFramer::ElmFramer()
+{
+}
+
+void ElmFramer::clear()
+{
+    m_head = 0;
+    m_tail = 0;
+    m_endHead = 0;
+    m_endTail = 0;
+    m_prompts = 0;
+}
+
+char *ElmFramer::writeBuffer(int &space)
+{
+    if(m_head - m_tail == static_cast<quint32>(CAPACITY))
+    {
+        // Nobody took the frames, or a line never ended: the oldest
+        // bytes go, the stream picks up again at the next line end.
+        Frame frame;
+        if(next(frame))
+        {
+            m_overflows += frame.length();
+        }
+        else
+        {
+            m_overflows += m_head - m_tail;
+            m_tail = m_head;
+        }
+    }
+
+    quint32 index = m_head & MASK;
+    quint32 free = CAPACITY - (m_head - m_tail);
+    space = static_cast<int>(std::min(free, CAPACITY - index));
+    return m_buffer + index;
+}
+
+void ElmFramer::commit(int size)
+{
+    // only what just came in is scanned
+    for(quint32 end = m_head + size; m_head != end; m_head++)
+    {
+        char c = m_buffer[m_head & MASK];
+        if(c == '\r' || c == '>')
+        {
+            m_ends[m_endHead++ & MASK] = m_head + 1;
+            if(c == '>')
+                m_prompts++;
+        }
+    }
+}
+
+void ElmFramer::append(const char *data, int size)
+{
+    while(size > 0)
+    {
+        int space = 0;
+        char *out = writeBuffer(space);
+        int count = std::min(space, size);
+        std::memcpy(out, data, count);
+        commit(count);
+
+        data += count;
+        size -= count;
+    }
+}
+
+bool ElmFramer::next(Frame &frame)
+{
+    if(m_endHead == m_endTail)
+        return false;
+
+    quint32 end = m_ends[m_endTail++ & MASK];
+    quint32 start = m_tail & MASK;
+    int length = static_cast<int>(end - m_tail);
+
+    frame.data = m_buffer + start;
+    frame.size = std::min(length, static_cast<int>(CAPACITY - start));
+    frame.wrapped = m_buffer;
+    frame.wrappedSize = length - frame.size;
+    frame.prompt = m_buffer[(end - 1) & MASK] == '>';
+
+    if(frame.prompt)
+        m_prompts--;
+    m_tail = end;
+    return true;
+}
+
+bool ElmFramer::takeReply(QByteArray &reply)
+{
+    if(m_prompts == 0)
+        return false;
+
+    reply.clear();
+    Frame frame;
+    while(next(frame))
+    {
+        frame.appendTo(reply);
+        if(frame.prompt)
+            break;
+    }
+    return true;
+}
+
+int ElmFramer::frames() const
+{
+    return static_cast<int>(m_endHead - m_endTail);
+}
+
+bool ElmFramer::hasReply() const
+{
+    return m_prompts > 0;
+}
+
+quint64 ElmFramer::overflows() const
+{
+    return m_overflows;
+}
+
+QString ElmFramer::benchmark(int frames)
+{
+    // ATMA output of a CAN bus with headers on, read in uneven chunks
+    QByteArray stream;
+    const char *lines[] = {
+        "7E8 04 41 0C 1A F8 \r",
+        "7E8 03 41 0D 32 \r",
+        "7E9 06 41 00 98 18 80 11 \r",
+        "7E8 03 41 05 7B \r"};
+    for(int i = 0; i < 256; i++)
+    {
+        stream.append(lines[i % 4]);
+    }
+    int streamFrames = 256;
+    int rounds = std::max(1, frames / streamFrames);
+
+    // as the sockets did: append to a block, cut lines off its front
+    QElapsedTimer timer;
+    timer.start();
+    quint64 start = AllocationCounter::count();
+    int blockBytes = 0;
+    for(int round = 0; round < rounds; round++)
+    {
+        QByteArray block;
+        for(int offset = 0, chunk = 1; offset < stream.size(); offset += chunk, chunk = chunk % 97 + 7)
+        {
+            block += stream.mid(offset, chunk);
+            int end = 0;
+            while((end = block.indexOf('\r')) >= 0)
+            {
+                QByteArray line = block.left(end + 1);
+                block.remove(0, end + 1);
+                blockBytes += line.size();
+            }
+        }
+    }
+    quint64 blockAllocations = AllocationCounter::count() - start;
+    qint64 blockTime = timer.nsecsElapsed();
+
+    ElmFramer *framer = new ElmFramer();
+    timer.restart();
+    start = AllocationCounter::count();
+    char line[64];
+    int ringBytes = 0;
+    for(int round = 0; round < rounds; round++)
+    {
+        for(int offset = 0, chunk = 1; offset < stream.size(); offset += chunk, chunk = chunk % 97 + 7)
+        {
+            framer->append(stream.constData() + offset, std::min(chunk, stream.size() - offset));
+            Frame frame;
+            while(framer->next(frame))
+            {
+                ringBytes += frame.copy(line, sizeof(line));
+            }
+        }
+    }
+    quint64 ringAllocations = AllocationCounter::count() - start;
+    qint64 ringTime = timer.nsecsElapsed();
+    delete framer;
+
+    double count = static_cast<double>(rounds) * streamFrames;
+    QString allocations = AllocationCounter::enabled()
+            ? QString(", %1 / %2 allocations").arg(blockAllocations / count, 0, 'f', 1).arg(ringAllocations / count, 0, 'f', 1)
+            : QString();
+
+    return QString("Framer: block %1 ns, ring %2 ns per frame (%3 frames)%4%5")
+            .arg(blockTime / count, 0, 'f', 0)
+            .arg(ringTime / count, 0, 'f', 0)
+            .arg(static_cast<qint64>(count))
+            .arg(allocations)
+            .arg(blockBytes == ringBytes ? QString() : QString(", outputs differ"));
+}
@@ -0,0 +1,69 @@
+#ifndef ELMFRAMER_H
+#define ELMFRAMER_H
+
+#include <QtCore>
+
+// Splits the adapter byte stream into frames over a fixed ring buffer.
+// The device is read straight into the ring, and only the new bytes are
+// scanned for the line end and the prompt, so a partial line waiting for
+// its rest costs nothing. A frame is one line with its '\r', or the
+// prompt, which ends a reply. Frames are handed out as views into the
+// ring, so a stream of monitor lines goes through without a copy or an
+// allocation.
+class ElmFramer
+{
+public:
+    static const int CAPACITY = 4096;   // bytes, a power of two
+
+    // A frame that wraps at the end of the ring comes in two parts.
+    struct Frame
+    {
+        const char *data{nullptr};
+        int size{0};
+        const char *wrapped{nullptr};
+        int wrappedSize{0};
+        bool prompt{false};             // '>', the reply is complete
+
+        int length() const;
+        // Writes at most capacity bytes, returns their number.
+        int copy(char *out, int capacity) const;
+        void appendTo(QByteArray &out) const;
+    };
+
+    ElmFramer();
+
+    void clear();
+
+    // Contiguous free space to read into, then commit() what was read.
+    char *writeBuffer(int &space);
+    void commit(int size);
+    void append(const char *data, int size);
+
+    // Oldest complete frame. The view stays valid until the next write.
+    bool next(Frame &frame);
+    // All frames up to and including the next prompt, false while no
+    // reply is complete.
+    bool takeReply(QByteArray &reply);
+
+    int frames() const;
+    bool hasReply() const;
+    // bytes of unterminated lines dropped on a full ring
+    quint64 overflows() const;
+
+    // Monitor stream in uneven chunks through the ring, one line of result.
+    static QString benchmark(int frames);
+
+private:
+    static const quint32 MASK = CAPACITY - 1;
+
+    char m_buffer[CAPACITY];
+    quint32 m_ends[CAPACITY];           // end of each complete frame
+    quint32 m_head{0};                  // next byte to write
+    quint32 m_tail{0};                  // first byte not handed out
+    quint32 m_endHead{0};
+    quint32 m_endTail{0};
+    int m_prompts{0};
+    quint64 m_overflows{0};
+};
+
+#endif // ELMFRAMER_H
@@ -0,0 +1,161 @@
+#include "elminitializer.h"
+
+ElmInitializer::ElmInitializer()
+{
+    setSettings(initializeCommands);
+}
+
+void ElmInitializer::setSettings(const QStringList &commands)
+{
+    m_settings.clear();
+    for(auto &command : commands)
+    {
+        if(command.startsWith("AT"))
+            m_settings.append(command);
+    }
+}
+
+bool ElmInitializer::run(const Request &request, const Drain &drain, const VehicleProfile &profile)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    m_sent = 0;
+    m_failed = 0;
+    m_adapterVersion.clear();
+    m_adapterDescription.clear();
+
+    bool ready = probe(request, drain);
+    if(ready)
+        identify(request);
+
+    bool known = !m_adapterVersion.isEmpty()
+            && m_adapterVersion == profile.getAdapterVersion()
+            && m_adapterDescription == profile.getAdapterDescription();
+
+    // Clones differ most in their reset handling, ATWS is only trusted on
+    // an adapter that has been set up before.
+    if(known && !m_echo)
+        m_start = NoReset;
+    else if(known)
+        m_start = WarmStart;
+    else
+        m_start = ColdStart;
+
+    if(m_start != NoReset)
+    {
+        ready = reset(request, drain, m_start == WarmStart ? SOFT_RESET : RESET);
+        if(ready && m_adapterVersion.isEmpty())
+            identify(request);
+    }
+
+    // ATE0 went out with the probe
+    for(auto &command : m_settings)
+    {
+        if(command == ECHO_OFF)
+            continue;
+
+        auto answer = request(command, SETTING_DEADLINE);
+        m_sent++;
+        if(!answer.contains("OK"))
+            m_failed++;
+    }
+
+    m_elapsed = timer.elapsed();
+    return ready && m_failed == 0;
+}
+
+bool ElmInitializer::probe(const Request &request, const Drain &drain)
+{
+    // ATE0 is part of the setup anyway; whether its answer still echoes
+    // the command tells an adapter at defaults from one already set up.
+    auto answer = request(ECHO_OFF, PROBE_DEADLINE);
+    m_sent++;
+    m_echo = answer.contains(ECHO_OFF);
+    if(m_echo)
+        drain();    // the OK follows the echoed line
+
+    return m_echo || answer.contains("OK");
+}
+
+void ElmInitializer::identify(const Request &request)
+{
+    m_adapterVersion = clean(request(GET_ELM_INFO, PROBE_DEADLINE), GET_ELM_INFO);
+
+    // many clones answer "?", an empty description still identifies them
+    m_adapterDescription = clean(request(GET_DEVICE_DESCRIPTION, PROBE_DEADLINE), GET_DEVICE_DESCRIPTION);
+    m_sent += 2;
+    if(m_adapterDescription == "?" || m_adapterDescription == "STOPPED")
+        m_adapterDescription.clear();
+    if(m_adapterVersion == "?" || m_adapterVersion == "STOPPED")
+        m_adapterVersion.clear();
+}
+
+bool ElmInitializer::reset(const Request &request, const Drain &drain, const QString &command)
+{
+    request(command, RESET_DEADLINE);
+    m_sent++;
+
+    // The banner follows the echoed command once the chip is up again,
+    // until then ATE0 is either ignored or answered behind the banner.
+    QElapsedTimer timer;
+    timer.start();
+    while(timer.elapsed() < RESET_DEADLINE)
+    {
+        drain();
+        auto answer = request(ECHO_OFF, PROBE_DEADLINE);
+        m_sent++;
+        if(answer.contains("OK"))
+        {
+            drain();
+            return true;
+        }
+    }
+    return false;
+}
+
+ElmInitializer::Start ElmInitializer::start() const
+{
+    return m_start;
+}
+
+QString ElmInitializer::adapterVersion() const
+{
+    return m_adapterVersion;
+}
+
+QString ElmInitializer::adapterDescription() const
+{
+    return m_adapterDescription;
+}
+
+qint64 ElmInitializer::elapsed() const
+{
+    return m_elapsed;
+}
+
+int ElmInitializer::failed() const
+{
+    return m_failed;
+}
+
+QString ElmInitializer::summary() const
+{
+    static const char *names[] = {"no reset", "warm start", "cold start"};
+
+    QString text = QString("Init: %1, %2 commands in %3 ms")
+            .arg(names[m_start])
+            .arg(m_sent)
+            .arg(m_elapsed);
+    if(m_failed)
+        text.append(QString(", %1 not accepted").arg(m_failed));
+    if(!m_adapterVersion.isEmpty())
+        text.append(", " + m_adapterVersion);
+    return text;
+}
+
+QString ElmInitializer::clean(QString answer, const QString &command)
+{
+    answer.remove(command).remove("\r").remove("\n").remove(">");
+    return answer.trimmed();
+}
@@ -0,0 +1,66 @@
+#ifndef ELMINITIALIZER_H
+#define ELMINITIALIZER_H
+
+#include <functional>
+#include "global.h"
+#include "vehicleprofile.h"
+
+// Plans the link setup from what the adapter still holds. The chip keeps
+// its AT settings until power is lost, so an adapter that answers with
+// echo off still carries the setup of an earlier session and needs no
+// reset. A known adapter back at its defaults gets the quick ATWS, only
+// an unknown or silent one the full ATZ. The settings are then sent
+// back to back, each as soon as the prompt of the last one is in.
+class ElmInitializer
+{
+public:
+    enum Start
+    {
+        NoReset,        // settings of an earlier session still active
+        WarmStart,      // known adapter at defaults, ATWS
+        ColdStart       // unknown or silent adapter, ATZ
+    };
+
+    // Sends one command and returns the raw answer, "STOPPED" after deadline ms.
+    typedef std::function<QString(const QString &, int)> Request;
+    // Discards what the adapter still sends for the last command.
+    typedef std::function<void()> Drain;
+
+    // ms
+    static const int PROBE_DEADLINE = 500;
+    static const int SETTING_DEADLINE = 500;
+    static const int RESET_DEADLINE = 3000;
+
+    ElmInitializer();
+
+    // AT commands of the link setup, in order; others are left out.
+    void setSettings(const QStringList &commands);
+
+    // Returns true when every setting was accepted.
+    bool run(const Request &request, const Drain &drain, const VehicleProfile &profile);
+
+    Start start() const;
+    QString adapterVersion() const;
+    QString adapterDescription() const;
+    qint64 elapsed() const;
+    int failed() const;
+    QString summary() const;
+
+private:
+    bool probe(const Request &request, const Drain &drain);
+    void identify(const Request &request);
+    bool reset(const Request &request, const Drain &drain, const QString &command);
+
+    static QString clean(QString answer, const QString &command);
+
+    QStringList m_settings{};
+    Start m_start{ColdStart};
+    bool m_echo{true};
+    QString m_adapterVersion{};
+    QString m_adapterDescription{};
+    qint64 m_elapsed{0};
+    int m_sent{0};
+    int m_failed{0};
+};
+
+#endif // ELMINITIALIZER_H
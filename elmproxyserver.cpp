@@ -0,0 +1,392 @@
+#include "elmproxyserver.h"
+#include "global.h"
+
+const int MAX_LINE = 256;      // chars without a CR, a client sending more is cut off
+const int RETRY = 20;          // ms, next try while the adapter is taken
+
+ElmProxyServer::ElmProxyServer(ConnectionManager *connection, QObject *parent) :
+    QObject(parent),
+    m_connection(connection)
+{
+}
+
+ElmProxyServer::~ElmProxyServer()
+{
+    close();
+}
+
+bool ElmProxyServer::listen(quint16 port)
+{
+    close();
+
+    if(!m_server)
+    {
+        m_server = new QTcpServer(this);
+        connect(m_server, &QTcpServer::newConnection, this, &ElmProxyServer::newConnection);
+    }
+
+    // tools on this machine only, the adapter is not shared further
+    if(!m_server->listen(QHostAddress::LocalHost, port))
+    {
+        emit stateChanged("Proxy: " + m_server->errorString());
+        return false;
+    }
+
+    m_requests = 0;
+    m_busRequests = 0;
+    m_merged = 0;
+    emit stateChanged(QString("Proxy listening on 127.0.0.1:%1").arg(m_server->serverPort()));
+    return true;
+}
+
+void ElmProxyServer::close()
+{
+    if(m_dispatchTimerId)
+        killTimer(m_dispatchTimerId);
+    m_dispatchTimerId = 0;
+    m_pending.clear();
+
+    for(auto socket : m_clients.keys())
+    {
+        socket->disconnect(this);
+        socket->abort();
+        socket->deleteLater();
+    }
+    m_clients.clear();
+
+    if(m_server)
+        m_server->close();
+}
+
+bool ElmProxyServer::isListening() const
+{
+    return m_server && m_server->isListening();
+}
+
+quint16 ElmProxyServer::port() const
+{
+    return m_server ? m_server->serverPort() : 0;
+}
+
+QString ElmProxyServer::summary() const
+{
+    return QString("Proxy %1: %2 clients, %3 bus requests from clients, %4 sent, %5 merged")
+            .arg(isListening() ? QString("on port %1").arg(port()) : QString("closed"))
+            .arg(m_clients.size())
+            .arg(m_requests)
+            .arg(m_busRequests)
+            .arg(m_merged);
+}
+
+void ElmProxyServer::newConnection()
+{
+    while(m_server->hasPendingConnections())
+    {
+        QTcpSocket *socket = m_server->nextPendingConnection();
+        socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+        m_clients.insert(socket, Client{});
+
+        connect(socket, &QTcpSocket::readyRead, this, &ElmProxyServer::clientReadyRead);
+        connect(socket, &QTcpSocket::disconnected, this, &ElmProxyServer::clientDisconnected);
+        emit stateChanged(QString("Proxy client %1:%2 connected, %3 in all")
+                          .arg(socket->peerAddress().toString()).arg(socket->peerPort()).arg(m_clients.size()));
+    }
+}
+
+void ElmProxyServer::clientReadyRead()
+{
+    auto socket = qobject_cast<QTcpSocket *>(sender());
+    if(!socket || !m_clients.contains(socket))
+        return;
+
+    Client &client = m_clients[socket];
+    client.input += socket->readAll();
+
+    int end = 0;
+    while((end = client.input.indexOf('\r')) >= 0)
+    {
+        QString command = QString::fromLatin1(client.input.constData(), end);
+        client.input.remove(0, end + 1);
+
+        // as the ELM reads it: no spaces, either case
+        command.remove(' ').remove('\n');
+        handle(socket, command.toUpper());
+    }
+
+    if(client.input.size() > MAX_LINE)
+        client.input.clear();
+}
+
+void ElmProxyServer::clientDisconnected()
+{
+    auto socket = qobject_cast<QTcpSocket *>(sender());
+    if(!socket || !m_clients.contains(socket))
+        return;
+
+    m_clients.remove(socket);
+    for(auto &pending : m_pending)
+    {
+        for(int i = pending.waiters.size() - 1; i >= 0; i--)
+        {
+            if(pending.waiters[i].socket == socket)
+                pending.waiters.removeAt(i);
+        }
+    }
+    socket->deleteLater();
+
+    emit stateChanged(QString("Proxy client left, %1 in all").arg(m_clients.size()));
+}
+
+void ElmProxyServer::handle(QTcpSocket *socket, const QString &command)
+{
+    Client &client = m_clients[socket];
+
+    // an empty line repeats the last command
+    QString request = command.isEmpty() ? client.lastCommand : command;
+    if(request.isEmpty())
+        return;
+    client.lastCommand = request;
+
+    if(!isBusRequest(request))
+    {
+        // echoed as it came, before an ATE0 takes effect
+        QByteArray out = client.echo ? request.toLatin1() + lineEnd(client) : QByteArray();
+        out += format(localReply(request, client), client);
+        socket->write(out);
+        return;
+    }
+
+    m_requests++;
+    if(!m_connection || !m_connection->isConnected())
+    {
+        reply(socket, request, "UNABLE TO CONNECT\r\r>");
+        return;
+    }
+
+    // waiting already for another client, it gets the same reply
+    QString bus = busCommand(request);
+    if(isMergeable(bus))
+    {
+        for(auto &pending : m_pending)
+        {
+            if(pending.command == bus)
+            {
+                pending.waiters.append(Waiter{socket, request});
+                m_merged++;
+                return;
+            }
+        }
+    }
+
+    m_pending.append(Pending{bus, QList<Waiter>{Waiter{socket, request}}});
+    schedule(0);
+}
+
+void ElmProxyServer::schedule(int interval)
+{
+    if(m_dispatchTimerId && interval == m_dispatchInterval)
+        return;
+
+    if(m_dispatchTimerId)
+        killTimer(m_dispatchTimerId);
+    m_dispatchTimerId = startTimer(interval);
+    m_dispatchInterval = interval;
+}
+
+void ElmProxyServer::timerEvent(QTimerEvent *event)
+{
+    Q_UNUSED(event)
+
+    // One bus request per turn, the clients are read in between and
+    // their requests pile up to be merged while the adapter is busy.
+    if(m_pending.isEmpty())
+    {
+        killTimer(m_dispatchTimerId);
+        m_dispatchTimerId = 0;
+        return;
+    }
+
+    if(!m_connection->isConnected())
+    {
+        for(auto &pending : m_pending)
+        {
+            for(auto &waiter : pending.waiters)
+            {
+                if(m_clients.contains(waiter.socket))
+                    reply(waiter.socket, waiter.request, "UNABLE TO CONNECT\r\r>");
+            }
+        }
+        m_pending.clear();
+        return;
+    }
+
+    // A view's request waits, this turn may come from its event loop, or
+    // the bus is backed off: readData would skip the request, which is
+    // not an answer. It stays first in line.
+    if(m_connection->isInFlight() || m_connection->isHoldingOff())
+    {
+        schedule(RETRY);
+        return;
+    }
+
+    Pending pending = m_pending.takeFirst();
+    if(pending.waiters.isEmpty())
+        return;
+
+    QByteArray response = m_connection->readData(pending.command);
+    if(response.isEmpty() || response == HELD_OFF)
+    {
+        // skipped after all, or the link went; the next turn sorts it out
+        m_pending.prepend(pending);
+        schedule(RETRY);
+        return;
+    }
+    m_busRequests++;
+    schedule(0);
+
+    if(!response.endsWith('>'))
+        response += "\r>";
+
+    for(auto &waiter : pending.waiters)
+    {
+        if(m_clients.contains(waiter.socket))
+            reply(waiter.socket, waiter.request, response);
+    }
+}
+
+bool ElmProxyServer::isBusRequest(const QString &command)
+{
+    // read only adapter requests share the bus queue
+    if(command == "ATRV" || command == "ATDP" || command == "ATDPN")
+        return true;
+
+    // ELM v1.3 and later take a response count digit after the pid
+    bool counted = command.size() >= 5 && command.size() % 2 != 0 &&
+            (command.startsWith("01") || command.startsWith("09"));
+    if(command.size() < 2 || (command.size() % 2 != 0 && !counted))
+        return false;
+
+    for(auto c : command)
+    {
+        if(!((c >= '0' && c <= '9') || (c >= 'A' && c <= 'F')))
+            return false;
+    }
+    return true;
+}
+
+bool ElmProxyServer::isMergeable(const QString &command)
+{
+    // Reads only: a clear codes (04) or a test request is sent for
+    // every client that asks.
+    static const QStringList modes{"01", "02", "03", "07", "09", "0A", "AT"};
+    return modes.contains(command.left(2));
+}
+
+QString ElmProxyServer::busCommand(const QString &request)
+{
+    // Without the response count digit: the same pid merges whatever
+    // count a client gave, and the connection adds the one it learned.
+    if(request.size() % 2 != 0 && !request.startsWith("AT"))
+        return request.left(request.size() - 1);
+
+    return request;
+}
+
+QByteArray ElmProxyServer::localReply(const QString &command, Client &client) const
+{
+    bool defaults = command == RESET || command == SOFT_RESET || command == SET_ALL_DEFAULT;
+    if(defaults)
+    {
+        client.echo = true;
+        client.spaces = true;
+        client.linefeeds = false;
+    }
+
+    if(command == RESET || command == SOFT_RESET)
+        return "\r\r" + banner().toLatin1() + "\r\r>";
+    if(command == GET_ELM_INFO)
+        return banner().toLatin1() + "\r\r>";
+    if(command == GET_DEVICE_DESCRIPTION && m_connection && !m_connection->initializer().adapterDescription().isEmpty())
+        return m_connection->initializer().adapterDescription().toLatin1() + "\r\r>";
+
+    if(command == ECHO_OFF || command == ECHO_ON)
+        client.echo = command == ECHO_ON;
+    else if(command == SPACES_OFF || command == SPACES_ON)
+        client.spaces = command == SPACES_ON;
+    else if(command == LINEFEED_OFF || command == LINEFEED_ON)
+        client.linefeeds = command == LINEFEED_ON;
+    else if(!defaults && !isKept(command))
+        return "?\r\r>";
+
+    return "OK\r\r>";
+}
+
+bool ElmProxyServer::isKept(const QString &command) const
+{
+    // Timing, memory and long messages change nothing a client reads.
+    // Headers stay off and formatting on; auto or the protocol in use
+    // is the one the app has set already.
+    static const QStringList same{HEADERS_OFF, FORMATTING_ON, ALLOW_LONG_MESSAGE, "ATNL", "ATM0", "ATM1", "ATPC",
+                                  ADAPTIF_TIMING_OFF, ADAPTIF_TIMING_AUTO1, ADAPTIF_TIMING_AUTO2, PROTOCOL_AUTO};
+    if(same.contains(command) || command.startsWith("ATST") || command.startsWith("ATSPA"))
+        return true;
+
+    QString protocol = m_connection ? m_connection->protocolDetector().protocol() : QString();
+    return !protocol.isEmpty() && (command == SET_PROTOCOL + protocol || command == TRY_PROTOCOL + protocol);
+}
+
+void ElmProxyServer::reply(QTcpSocket *socket, const QString &command, const QByteArray &reply)
+{
+    const Client &client = m_clients[socket];
+    QByteArray out = client.echo ? command.toLatin1() + lineEnd(client) : QByteArray();
+    out += format(reply, client);
+    socket->write(out);
+}
+
+QByteArray ElmProxyServer::format(const QByteArray &reply, const Client &client)
+{
+    // The adapter answers in the app's format. Data lines are spaced as
+    // the client asked, text lines ("NO DATA", CAN frame numbers) and the
+    // prompt go as they are.
+    QByteArray out;
+    bool first = true;
+    for(auto &line : reply.split('\r'))
+    {
+        if(!first)
+            out += lineEnd(client);
+        first = false;
+
+        QByteArray data = line;
+        data.replace(" ", "");
+        bool hex = !data.isEmpty() && data.size() % 2 == 0;
+        for(int i = 0; hex && i < data.size(); i++)
+        {
+            char c = data.at(i);
+            hex = (c >= '0' && c <= '9') || (c >= 'A' && c <= 'F');
+        }
+        if(!hex)
+        {
+            out += line;
+            continue;
+        }
+
+        for(int i = 0; i < data.size(); i += 2)
+        {
+            if(i > 0 && client.spaces)
+                out += ' ';
+            out += data.mid(i, 2);
+        }
+    }
+    return out;
+}
+
+QByteArray ElmProxyServer::lineEnd(const Client &client)
+{
+    return client.linefeeds ? QByteArray("\r\n") : QByteArray("\r");
+}
+
+QString ElmProxyServer::banner() const
+{
+    QString version = m_connection ? m_connection->initializer().adapterVersion() : QString();
+    return version.isEmpty() ? QString("ELM327 v1.5") : version;
+}
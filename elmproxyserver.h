@@ -0,0 +1,93 @@
+#ifndef ELMPROXYSERVER_H
+#define ELMPROXYSERVER_H
+
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include "connectionmanager.h"
+
+// Shares the adapter of a connection with other tools: it listens as an
+// ELM327 would and passes their requests on. Identical requests waiting
+// at the same time go to the bus once and the reply goes back to each
+// client, so tools polling the same pids do not split the sample rate.
+// The adapter settings belong to the app. Echo, spaces and linefeeds are
+// kept per client and applied to its replies; AT commands that change
+// nothing a client reads are answered OK, the others (headers, ATSH,
+// another protocol, ...) with "?" as a chip without them would.
+class ElmProxyServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const quint16 DEFAULT_PORT = 35001;  // beside the usual 35000
+
+    explicit ElmProxyServer(ConnectionManager *connection, QObject *parent = nullptr);
+    ~ElmProxyServer() override;
+
+    bool listen(quint16 port = DEFAULT_PORT);
+    void close();
+    bool isListening() const;
+    quint16 port() const;
+
+    // Clients, their bus requests and how many were merged, one line.
+    QString summary() const;
+
+signals:
+    void stateChanged(QString);
+
+protected:
+    void timerEvent(QTimerEvent *) override;
+
+private slots:
+    void newConnection();
+    void clientReadyRead();
+    void clientDisconnected();
+
+private:
+    struct Client
+    {
+        QByteArray input;
+        QString lastCommand;
+        bool echo{true};
+        bool spaces{true};
+        bool linefeeds{false};
+    };
+
+    // a client and its request as it sent it, echoed with the reply
+    struct Waiter
+    {
+        QTcpSocket *socket;
+        QString request;
+    };
+
+    // one bus request and everybody waiting for its reply
+    struct Pending
+    {
+        QString command;
+        QList<Waiter> waiters;
+    };
+
+    void handle(QTcpSocket *socket, const QString &command);
+    void schedule(int interval);
+    static bool isBusRequest(const QString &command);
+    static bool isMergeable(const QString &command);
+    static QString busCommand(const QString &request);
+    QByteArray localReply(const QString &command, Client &client) const;
+    bool isKept(const QString &command) const;
+    void reply(QTcpSocket *socket, const QString &command, const QByteArray &reply);
+    static QByteArray format(const QByteArray &reply, const Client &client);
+    static QByteArray lineEnd(const Client &client);
+    QString banner() const;
+
+    ConnectionManager *m_connection{};
+    QTcpServer *m_server{};
+    QHash<QTcpSocket *, Client> m_clients{};
+    QList<Pending> m_pending{};
+    int m_dispatchTimerId{0};
+    int m_dispatchInterval{0};
+    quint64 m_requests{0};
+    quint64 m_busRequests{0};
+    quint64 m_merged{0};
+};
+
+#endif // ELMPROXYSERVER_H
@@ -0,0 +1,130 @@
+#include "elmrecovery.h"
+
+namespace
+{
+const qint64 MIN_BACKOFF = 50;          // ms
+const qint64 MAX_BACKOFF = 3200;        // ms
+const qint64 REINIT_HOLD = 30000;       // ms between two re-inits for UNABLE TO CONNECT
+}
+
+ElmRecovery::ElmRecovery()
+{
+}
+
+void ElmRecovery::reset()
+{
+    m_counters = Counters();
+    m_backoff = 0;
+    m_resumeAt = 0;
+    m_lastReinit = 0;
+}
+
+bool ElmRecovery::holdOff(qint64 now)
+{
+    if(now >= m_resumeAt)
+        return false;
+
+    m_counters.heldOff++;
+    return true;
+}
+
+bool ElmRecovery::isHoldingOff(qint64 now) const
+{
+    return now < m_resumeAt;
+}
+
+ElmRecovery::Action ElmRecovery::handle(const QByteArray &response, qint64 now, bool parked)
+{
+    // the adapter writes its messages upper case
+    if(response.contains("BUS BUSY"))
+    {
+        m_counters.busBusy++;
+        return startBackoff(now);
+    }
+
+    if(response.contains("CAN ERROR") || response.contains("BUS ERROR") ||
+            response.contains("FB ERROR") || response.contains("RX ERROR"))
+    {
+        m_counters.busError++;
+        return startBackoff(now);
+    }
+
+    if(response.contains("BUFFER FULL"))
+    {
+        m_counters.bufferFull++;
+        return Drain;
+    }
+
+    if(response.contains("STOPPED"))
+    {
+        m_counters.stopped++;
+        return Retry;
+    }
+
+    if(response.contains("LV RESET"))
+    {
+        // the chip restarted with default settings
+        m_counters.lowVoltageReset++;
+        m_counters.reinitialized++;
+        m_lastReinit = now;
+        return Reinitialize;
+    }
+
+    if(response.contains("UNABLE TO CONNECT"))
+    {
+        // Also what a sleeping ecu answers, so re-init only now and then.
+        m_counters.unableToConnect++;
+        if(!parked && (m_lastReinit == 0 || now - m_lastReinit >= REINIT_HOLD))
+        {
+            m_counters.reinitialized++;
+            m_lastReinit = now;
+            return Reinitialize;
+        }
+        return startBackoff(now);
+    }
+
+    // a clean answer ends the backoff
+    m_backoff = 0;
+    return None;
+}
+
+void ElmRecovery::expired()
+{
+    m_counters.expired++;
+}
+
+void ElmRecovery::preempted()
+{
+    m_counters.preempted++;
+}
+
+qint64 ElmRecovery::backoff() const
+{
+    return m_backoff;
+}
+
+const ElmRecovery::Counters &ElmRecovery::counters() const
+{
+    return m_counters;
+}
+
+QString ElmRecovery::summary() const
+{
+    return "busy " + QString::number(m_counters.busBusy) +
+            ", bus error " + QString::number(m_counters.busError) +
+            ", buffer full " + QString::number(m_counters.bufferFull) +
+            ", stopped " + QString::number(m_counters.stopped) +
+            ", unable to connect " + QString::number(m_counters.unableToConnect) +
+            ", lv reset " + QString::number(m_counters.lowVoltageReset) +
+            ", reinit " + QString::number(m_counters.reinitialized) +
+            ", held off " + QString::number(m_counters.heldOff) +
+            ", expired " + QString::number(m_counters.expired) +
+            ", preempted " + QString::number(m_counters.preempted);
+}
+
+ElmRecovery::Action ElmRecovery::startBackoff(qint64 now)
+{
+    m_backoff = m_backoff == 0 ? MIN_BACKOFF : std::min(MAX_BACKOFF, m_backoff * 2);
+    m_resumeAt = now + m_backoff;
+    return Backoff;
+}
@@ -0,0 +1,65 @@
+#ifndef ELMRECOVERY_H
+#define ELMRECOVERY_H
+
+#include <QtCore>
+
+// Reaction of the command layer to ELM error answers, by error type.
+// Bus contention backs off exponentially instead of adding to it, a full
+// adapter buffer is drained and the request sent again, an interrupted
+// request is resent at once and a lost link or adapter reset runs the
+// init sequence again. Every path is counted.
+class ElmRecovery
+{
+public:
+    enum Action
+    {
+        None,           // answer is usable, or nothing to do
+        Retry,          // send the same request again now
+        Drain,          // discard pending input, then retry
+        Backoff,        // keep off the bus for backoff() ms
+        Reinitialize    // send the init sequence again
+    };
+
+    struct Counters
+    {
+        quint64 busBusy{0};
+        quint64 busError{0};
+        quint64 bufferFull{0};
+        quint64 stopped{0};
+        quint64 unableToConnect{0};
+        quint64 lowVoltageReset{0};
+        quint64 reinitialized{0};
+        quint64 heldOff{0};         // requests not sent during a backoff
+        quint64 expired{0};         // deadline reached, adapter stopped
+        quint64 preempted{0};       // stopped for an urgent request
+    };
+
+    ElmRecovery();
+
+    void reset();
+
+    // True while backing off, the request should not go out.
+    bool holdOff(qint64 now);
+    // The same without counting, for a caller deciding whether to ask.
+    bool isHoldingOff(qint64 now) const;
+    // Classifies an answer and decides what to do about it. A parked
+    // vehicle answers UNABLE TO CONNECT with its ecu asleep, that backs
+    // off without a re-init.
+    Action handle(const QByteArray &response, qint64 now, bool parked = false);
+    void expired();
+    void preempted();
+
+    qint64 backoff() const;
+    const Counters &counters() const;
+    QString summary() const;
+
+private:
+    Action startBackoff(qint64 now);
+
+    Counters m_counters{};
+    qint64 m_backoff{0};
+    qint64 m_resumeAt{0};
+    qint64 m_lastReinit{0};
+};
+
+#endif // ELMRECOVERY_H
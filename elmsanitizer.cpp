@@ -0,0 +1,240 @@
+#include "elmsanitizer.h"
+#include <cstring>
+
+// ELM messages as they look without spaces; checked only on replies with
+// text, a pid answer never gets here.
+static const char *ERROR_MESSAGES[] = {
+    "ACTALERT",
+    "BUFFERFULL",
+    "BUSBUSY",
+    "BUSERROR",
+    "CANERROR",
+    "DATAERROR",
+    "ERR",
+    "FBERROR",
+    "HELDOFF",
+    "LPALERT",
+    "LVRESET",
+    "NODATA",
+    "RXERROR",
+    "STOPPED",
+    "UNABLETOCONNECT",
+    "SEARCHING"};
+
+static inline ushort code(char c)
+{
+    return static_cast<uchar>(c);
+}
+
+static inline ushort code(const QChar &c)
+{
+    return c.unicode();
+}
+
+template<class Char>
+static quint32 scan(const Char *data, int size, char *out, int capacity, int &length)
+{
+    quint32 flags = 0;
+    int lines = 0;
+    bool content = false;
+    length = 0;
+
+    for(int i = 0; i < size; i++)
+    {
+        ushort c = code(data[i]);
+
+        if(c >= 'a' && c <= 'z')
+            c -= 'a' - 'A';
+
+        if((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z'))
+        {
+            if(c > 'F')
+                flags |= ElmSanitizer::Text;
+            if(length < capacity)
+                out[length++] = static_cast<char>(c);
+            else
+                flags |= ElmSanitizer::Truncated;
+            content = true;
+        }
+        else if(c == '\r' || c == '\n')
+        {
+            if(content)
+                lines++;
+            content = false;
+        }
+        else if(c == '>')
+        {
+            flags |= ElmSanitizer::Prompt;
+        }
+        else if(c == '?')
+        {
+            flags |= ElmSanitizer::Unknown;
+        }
+    }
+
+    if(content)
+        lines++;
+    if(lines > 1)
+        flags |= ElmSanitizer::Multiline;
+
+    return flags;
+}
+
+quint32 ElmSanitizer::sanitize(const char *data, int size, char *out, int capacity, int &length)
+{
+    quint32 flags = scan(data, size, out, capacity, length);
+    if((flags & Text) && isError(out, length))
+        flags |= Error;
+    return flags;
+}
+
+quint32 ElmSanitizer::sanitize(const QByteArray &reply, char *out, int capacity, int &length)
+{
+    return sanitize(reply.constData(), reply.size(), out, capacity, length);
+}
+
+quint32 ElmSanitizer::sanitize(const QString &reply, char *out, int capacity, int &length)
+{
+    quint32 flags = scan(reply.constData(), reply.size(), out, capacity, length);
+    if((flags & Text) && isError(out, length))
+        flags |= Error;
+    return flags;
+}
+
+QString ElmSanitizer::clean(const QString &reply, quint32 *flags)
+{
+    char buffer[REPLY_CAPACITY];
+    int length = 0;
+
+    quint32 result = sanitize(reply, buffer, REPLY_CAPACITY, length);
+    if(result & Truncated)
+    {
+        // never more chars out than in
+        QByteArray heap(reply.size(), Qt::Uninitialized);
+        result = sanitize(reply, heap.data(), heap.size(), length);
+        heap.truncate(length);
+        if(flags)
+            *flags = result;
+        return QString::fromLatin1(heap);
+    }
+    if(flags)
+        *flags = result;
+
+    return QString::fromLatin1(buffer, length);
+}
+
+QByteArray ElmSanitizer::clean(const QByteArray &reply, quint32 *flags)
+{
+    char buffer[REPLY_CAPACITY];
+    int length = 0;
+
+    quint32 result = sanitize(reply, buffer, REPLY_CAPACITY, length);
+    if(result & Truncated)
+    {
+        QByteArray heap(reply.size(), Qt::Uninitialized);
+        result = sanitize(reply, heap.data(), heap.size(), length);
+        heap.truncate(length);
+        if(flags)
+            *flags = result;
+        return heap;
+    }
+    if(flags)
+        *flags = result;
+
+    return QByteArray(buffer, length);
+}
+
+bool ElmSanitizer::isError(const char *text, int length)
+{
+    for(const char *message : ERROR_MESSAGES)
+    {
+        int size = static_cast<int>(std::strlen(message));
+        for(int i = 0; i + size <= length; i++)
+        {
+            if(std::memcmp(text + i, message, size) == 0)
+                return true;
+        }
+    }
+    return false;
+}
+
+QString ElmSanitizer::benchmark(int iterations)
+{
+    // one ecu compact and spaced, two ecus, a dtc list, an error, ATRV
+    const QStringList replies{
+        "410C1AF8\r\r>",
+        "41 0C 1A F8 \r\r>",
+        "41 00 BE 3F A8 13 \r41 00 98 18 80 11 \r\r>",
+        "43 01 33 00 00 00 00 \r43 02 03 01 04 00 00 \r\r>",
+        "NO DATA\r\r>",
+        "12.4V\r\r>"};
+
+    int bytes = 0;
+    for(auto &reply : replies)
+    {
+        bytes += reply.size();
+    }
+
+    // the chain as it was in every receive path
+    auto chain = [](const QString &reply)
+    {
+        QString data = reply;
+        data.remove("\r");
+        data.remove(">");
+        data.remove("?");
+        data.remove(",");
+        data = data.trimmed().simplified();
+        data.remove(QRegExp("[\\n\\t\\r]"));
+        data.remove(QRegExp("[^a-zA-Z0-9]+"));
+        return data;
+    };
+
+    // timings of two passes that do not agree say nothing
+    char buffer[REPLY_CAPACITY];
+    int length = 0;
+    for(auto &reply : replies)
+    {
+        QByteArray expected = chain(reply).toLatin1();
+        sanitize(reply, buffer, REPLY_CAPACITY, length);
+        if(length != expected.size() || std::memcmp(buffer, expected.constData(), static_cast<size_t>(length)) != 0)
+        {
+            return QString("Sanitizer: outputs differ for \"%1\": chain \"%2\", single pass \"%3\"")
+                    .arg(QString(reply).replace("\r", "\\r"))
+                    .arg(QString::fromLatin1(expected))
+                    .arg(QString::fromLatin1(buffer, length));
+        }
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    int chainLength = 0;
+    for(int i = 0; i < iterations; i++)
+    {
+        for(auto &reply : replies)
+        {
+            chainLength += chain(reply).size();
+        }
+    }
+    qint64 chained = timer.nsecsElapsed();
+
+    timer.restart();
+    int scanLength = 0;
+    for(int i = 0; i < iterations; i++)
+    {
+        for(auto &reply : replies)
+        {
+            sanitize(reply, buffer, REPLY_CAPACITY, length);
+            scanLength += length;
+        }
+    }
+    qint64 single = timer.nsecsElapsed();
+
+    // the lengths only keep both loops from being optimized away
+    double count = static_cast<double>(iterations) * replies.size();
+    return QString("Sanitizer: chain %1 ns, single pass %2 ns per reply (%3 replies of %4 bytes avg, %5 chars out)")
+            .arg(chained / count, 0, 'f', 0)
+            .arg(single / count, 0, 'f', 0)
+            .arg(static_cast<qint64>(count))
+            .arg(bytes / replies.size())
+            .arg(chainLength + scanLength);
+}
@@ -0,0 +1,44 @@
+#ifndef ELMSANITIZER_H
+#define ELMSANITIZER_H
+
+#include <QtCore>
+
+// Cleans adapter replies for the decoders in one pass over the raw bytes.
+// The letters and digits of the reply are written upper case into a buffer
+// of the caller, spaces, line ends, the prompt and separators are dropped,
+// so the result is the same for every wire profile. What the old cleanup
+// chain and the error list search found out on the way comes back as flags.
+class ElmSanitizer
+{
+public:
+    enum Flag
+    {
+        Prompt      = 0x01,     // '>' seen, the reply is complete
+        Multiline   = 0x02,     // more than one line with content, several ecus
+        Text        = 0x04,     // letters beyond hex digits: an AT answer or a message
+        Error       = 0x08,     // one of the ELM error messages
+        Unknown     = 0x10,     // '?', command not understood
+        Truncated   = 0x20      // more chars than capacity, the rest is dropped
+    };
+
+    static const int REPLY_CAPACITY = 512;     // chars, enough for a pid answer
+
+    // Writes at most capacity chars to out and their number to length.
+    // Allocates nothing; returns the flags.
+    static quint32 sanitize(const char *data, int size, char *out, int capacity, int &length);
+    static quint32 sanitize(const QByteArray &reply, char *out, int capacity, int &length);
+    static quint32 sanitize(const QString &reply, char *out, int capacity, int &length);
+
+    // sanitize() into a QString, the one allocation being the result;
+    // a reply longer than REPLY_CAPACITY is sanitized again into the heap
+    static QString clean(const QString &reply, quint32 *flags = nullptr);
+    static QByteArray clean(const QByteArray &reply, quint32 *flags = nullptr);
+
+    // Old chain against sanitize() over typical replies, one line of result.
+    static QString benchmark(int iterations);
+
+private:
+    static bool isError(const char *text, int length);
+};
+
+#endif // ELMSANITIZER_H
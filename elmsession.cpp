@@ -0,0 +1,181 @@
+#include "elmsession.h"
+#include "global.h"
+
+const int STOP_CHECK = 10;     // ms between looks for a request still waiting
+
+ElmSession::ElmSession(const LinkSettings &link, QObject *parent) :
+    QObject(parent),
+    m_link(link)
+{
+    m_commands = QStringList{ENGINE_RPM, VEHICLE_SPEED, COOLANT_TEMP, MAN_ABSOLUTE_PRESSURE, ENGINE_LOAD};
+}
+
+ElmSession::~ElmSession()
+{
+    // stopped on its own thread already, this only frees what is left
+    delete m_connection;
+    delete m_elm;
+}
+
+QString ElmSession::name() const
+{
+    return m_link.ip + ":" + QString::number(m_link.port);
+}
+
+void ElmSession::setCommands(const QStringList &commands)
+{
+    m_commands = commands;
+}
+
+void ElmSession::setInterval(int milliseconds)
+{
+    m_interval = milliseconds;
+}
+
+bool ElmSession::isConnected() const
+{
+    return m_connected;
+}
+
+quint64 ElmSession::replies() const
+{
+    return m_replies;
+}
+
+quint64 ElmSession::samples() const
+{
+    return m_samples;
+}
+
+void ElmSession::start()
+{
+    if(m_connection)
+        return;
+
+    // made here, so the socket and timers belong to the session thread
+    m_connection = new ConnectionManager(m_link, this);
+    m_elm = new ELM(m_connection);
+
+    connect(m_connection, &ConnectionManager::connected, this, &ElmSession::conConnected);
+    connect(m_connection, &ConnectionManager::resumed, this, &ElmSession::conResumed);
+    connect(m_connection, &ConnectionManager::disconnected, this, &ElmSession::conDisconnected);
+    connect(m_connection, &ConnectionManager::stateChanged, this, &ElmSession::conStateChanged);
+
+    m_connection->setPollInterval(m_interval);
+    m_connection->connectElm();
+}
+
+void ElmSession::stop()
+{
+    if(m_timerId)
+        killTimer(m_timerId);
+    m_timerId = 0;
+
+    // Mostly called from the event loop of a waiting readData, with the
+    // link still on the stack; it is taken down from the top level.
+    if(!m_stopTimerId)
+        m_stopTimerId = startTimer(STOP_CHECK);
+}
+
+void ElmSession::finish()
+{
+    if(m_stopTimerId)
+        killTimer(m_stopTimerId);
+    m_stopTimerId = 0;
+
+    if(m_connection)
+    {
+        m_connection->disConnectElm();
+        delete m_connection;
+        m_connection = nullptr;
+    }
+    delete m_elm;
+    m_elm = nullptr;
+    m_connected = false;
+
+    emit stopped();
+}
+
+void ElmSession::conConnected()
+{
+    m_connection->initializeAdapter();
+
+    // a pid the car does not have only costs its ecu timeout every round
+    m_elm->resetPids();
+    m_elm->get_available_pids();
+    QStringList commands;
+    for(auto &command : m_commands)
+    {
+        bool ok = false;
+        quint8 pid = static_cast<quint8>(command.mid(2, 2).toUInt(&ok, 16));
+        if(!command.startsWith("01") || !ok || m_elm->isPidAvailable(pid))
+            commands.append(command);
+    }
+    m_commands = commands;
+    m_commandOrder = 0;
+
+    emit stateChanged(QString("%1: polling %2").arg(name()).arg(m_commands.join(", ")));
+    conResumed();
+}
+
+void ElmSession::conResumed()
+{
+    m_connected = true;
+    // a link that came up while stopping is not polled
+    if(!m_timerId && !m_stopTimerId && !m_commands.isEmpty())
+        m_timerId = startTimer(m_interval);
+}
+
+void ElmSession::conDisconnected()
+{
+    // the link reconnects by itself, polling goes on after resumed()
+    m_connected = false;
+    if(m_timerId)
+        killTimer(m_timerId);
+    m_timerId = 0;
+}
+
+void ElmSession::conStateChanged(QString state)
+{
+    emit stateChanged(name() + ": " + state);
+}
+
+void ElmSession::timerEvent(QTimerEvent *event)
+{
+    if(event->timerId() == m_stopTimerId)
+    {
+        if(!m_connection || !m_connection->isInFlight())
+            finish();
+        return;
+    }
+
+    if(!m_connection || !m_connection->isConnected())
+        return;
+
+    if(m_commandOrder >= m_commands.size())
+        m_commandOrder = 0;
+
+    poll(m_commands[m_commandOrder++]);
+}
+
+void ElmSession::poll(const QString &command)
+{
+    QByteArray reply = m_connection->readData(command);
+    // backed off, nothing was asked
+    if(reply.isEmpty() || reply == HELD_OFF)
+        return;
+    m_replies++;
+
+    char data[ElmSanitizer::REPLY_CAPACITY];
+    int length = 0;
+    ElmSanitizer::sanitize(reply, data, ElmSanitizer::REPLY_CAPACITY, length);
+
+    unsigned pid = 0;
+    unsigned A = 0;
+    unsigned B = 0;
+    if(ELM::decodePid(data, length, pid, A, B))
+    {
+        m_samples++;
+        emit sampled(static_cast<int>(pid), A, B, currentTimeMillis());
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef ELMSESSION_H
+#define ELMSESSION_H
+
+#include <QObject>
+#include <atomic>
+#include "connectionmanager.h"
+#include "elm.h"
+
+// One wifi adapter with all it needs: its own link, poll list and
+// decoder. A session is moved to a thread of its own and builds its link
+// there, so the blocking reads of one adapter never hold up another.
+// Counters may be read from any thread.
+class ElmSession : public QObject
+{
+    Q_OBJECT
+
+public:
+    // link read from the settings by the caller, on the GUI thread
+    explicit ElmSession(const LinkSettings &link, QObject *parent = nullptr);
+    ~ElmSession() override;
+
+    // "ip:port"
+    QString name() const;
+    // Set before start, the list is polled round robin.
+    void setCommands(const QStringList &commands);
+    void setInterval(int milliseconds);
+
+    bool isConnected() const;
+    quint64 replies() const;
+    quint64 samples() const;
+
+public slots:
+    // Both on the session thread. stop() returns at once, the link goes
+    // down once no request waits and stopped() follows.
+    void start();
+    void stop();
+
+signals:
+    // a decoded mode 01 reply, data bytes A and B
+    void sampled(int pid, uint A, uint B, qint64 timestamp);
+    void stateChanged(QString);
+    void stopped();
+
+protected:
+    void timerEvent(QTimerEvent *) override;
+
+private slots:
+    void conConnected();
+    void conResumed();
+    void conDisconnected();
+    void conStateChanged(QString);
+
+private:
+    void poll(const QString &command);
+    void finish();
+
+    LinkSettings m_link{};
+    QStringList m_commands{};
+    int m_interval{0};
+    int m_commandOrder{0};
+    int m_timerId{0};
+    int m_stopTimerId{0};
+    ConnectionManager *m_connection{};
+    ELM *m_elm{};
+    std::atomic<bool> m_connected{false};
+    std::atomic<quint64> m_replies{0};
+    std::atomic<quint64> m_samples{0};
+};
+
+#endif // ELMSESSION_H
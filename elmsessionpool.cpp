@@ -0,0 +1,110 @@
+#include "elmsessionpool.h"
+
+ElmSessionPool::ElmSessionPool(QObject *parent) :
+    QObject(parent)
+{
+}
+
+ElmSessionPool::~ElmSessionPool()
+{
+    stop();
+}
+
+void ElmSessionPool::start(const QStringList &endpoints, int interval)
+{
+    stop();
+
+    // read here, the sessions never touch the settings from their threads
+    QString wireProfile = SettingsManager::getInstance()->getWireProfile();
+
+    for(auto &endpoint : endpoints)
+    {
+        QString ip = endpoint.section(':', 0, 0);
+        quint16 port = static_cast<quint16>(endpoint.section(':', 1, 1).toUInt());
+        if(ip.isEmpty() || port == 0)
+        {
+            emit stateChanged("Not an ip:port endpoint: " + endpoint);
+            continue;
+        }
+
+        // no parent, a session lives on its thread and is deleted here
+        ElmSession *session = new ElmSession(LinkSettings{ip, port, wireProfile});
+        session->setInterval(interval);
+        QThread *thread = new QThread(this);
+        session->moveToThread(thread);
+        SessionLogger *logger = new SessionLogger(session->name());
+        logger->moveToThread(thread);
+
+        connect(thread, &QThread::started, session, &ElmSession::start);
+        connect(session, &ElmSession::sampled, logger, &SessionLogger::sampled);
+        // closed before the thread ends, in connection order
+        connect(session, &ElmSession::stopped, logger, &SessionLogger::close, Qt::DirectConnection);
+        connect(session, &ElmSession::stopped, thread, &QThread::quit, Qt::DirectConnection);
+        connect(session, &ElmSession::stateChanged, this, &ElmSessionPool::stateChanged);
+
+        m_workers.append(Worker{session, thread, logger});
+        thread->start();
+    }
+    m_elapsed.start();
+}
+
+void ElmSessionPool::stop()
+{
+    // All at once, each link goes down on its own thread once its
+    // request is answered, then the thread ends.
+    for(auto &worker : m_workers)
+    {
+        QMetaObject::invokeMethod(worker.session, "stop", Qt::QueuedConnection);
+    }
+    for(auto &worker : m_workers)
+    {
+        worker.thread->wait();
+        delete worker.logger;
+        delete worker.session;
+        delete worker.thread;
+    }
+    m_workers.clear();
+}
+
+bool ElmSessionPool::isRunning() const
+{
+    return !m_workers.isEmpty();
+}
+
+QList<ElmSession *> ElmSessionPool::sessions() const
+{
+    QList<ElmSession *> sessions;
+    for(auto &worker : m_workers)
+    {
+        sessions.append(worker.session);
+    }
+    return sessions;
+}
+
+QStringList ElmSessionPool::summary() const
+{
+    QStringList lines;
+    double seconds = std::max<qint64>(m_elapsed.elapsed(), 1) / 1000.0;
+    quint64 replies = 0;
+    quint64 samples = 0;
+    for(auto &worker : m_workers)
+    {
+        ElmSession *session = worker.session;
+        replies += session->replies();
+        samples += session->samples();
+        lines.append(QString("%1 %2: %3 replies, %4 samples, %5/s, %6 logged to %7")
+                     .arg(session->name())
+                     .arg(session->isConnected() ? "connected" : "not connected")
+                     .arg(session->replies())
+                     .arg(session->samples())
+                     .arg(session->replies() / seconds, 0, 'f', 1)
+                     .arg(worker.logger->lines())
+                     .arg(worker.logger->fileName()));
+    }
+    lines.append(QString("Sessions: %1 in %2 s, %3 replies/s and %4 samples/s in total")
+                 .arg(m_workers.size())
+                 .arg(seconds, 0, 'f', 1)
+                 .arg(replies / seconds, 0, 'f', 1)
+                 .arg(samples / seconds, 0, 'f', 1));
+    return lines;
+}
@@ -0,0 +1,47 @@
+#ifndef ELMSESSIONPOOL_H
+#define ELMSESSIONPOOL_H
+
+#include <QObject>
+#include <QThread>
+#include <QElapsedTimer>
+#include "elmsession.h"
+#include "sessionlogger.h"
+
+// Several adapters polled side by side, one session and one thread per
+// adapter, each logged to a csv of its own. A socket belongs to the thread it was made on and a blocking
+// read holds that thread, so the sessions do not share threads; with one
+// each, the reply rate grows with the number of adapters.
+class ElmSessionPool : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ElmSessionPool(QObject *parent = nullptr);
+    ~ElmSessionPool() override;
+
+    // "ip:port" entries, the running sessions are stopped first
+    void start(const QStringList &endpoints, int interval = 0);
+    void stop();
+    bool isRunning() const;
+    // to connect to their samples, on the session threads
+    QList<ElmSession *> sessions() const;
+
+    // Replies per second and log file of each session and of all, one line each.
+    QStringList summary() const;
+
+signals:
+    void stateChanged(QString);
+
+private:
+    struct Worker
+    {
+        ElmSession *session;
+        QThread *thread;
+        SessionLogger *logger;
+    };
+
+    QList<Worker> m_workers{};
+    QElapsedTimer m_elapsed{};
+};
+
+#endif // ELMSESSIONPOOL_H
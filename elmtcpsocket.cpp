@@ -1,7 +1,28 @@
 #include "elmtcpsocket.h"
 #include <QDebug>
+#include <QElapsedTimer>
+#include <QScopedValueRollback>
+#include <algorithm>
+#if defined(Q_OS_LINUX) || defined(Q_OS_ANDROID)
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#endif
 
-ElmTcpSocket::ElmTcpSocket(QObject *parent)
+const int CONNECT_TIMEOUT = 2000;   // ms, a wifi adapter answers well within
+// bytes; a command is a few, a reply rarely more than a hundred, an ATMA
+// stream what the framer holds a few times over
+const int SEND_BUFFER = 1024;
+const int RECEIVE_BUFFER = 4 * ElmFramer::CAPACITY;
+// s; the system default waits two hours before the first probe
+const int KEEPALIVE_IDLE = 5;
+const int KEEPALIVE_INTERVAL = 2;
+const int KEEPALIVE_PROBES = 3;
+// requests in a row that ran into their deadline without a byte back
+const int SILENT_EXPIRIES = 3;
+
+ElmTcpSocket::ElmTcpSocket(QObject *parent) :
+    QThread(parent)
 {
 
 }
@@ -22,7 +43,14 @@ void ElmTcpSocket::connectTcp(const QString &ip, const quint16 &port)
     QString msg{};
     msg.append("Connecting to Wifi " + ip + " : " + QString::number(port));
     emit stateChanged(msg);
-    QCoreApplication::processEvents();
+
+    // a socket of an earlier attempt must not report into this one
+    if(socket)
+    {
+        socket->disconnect(this);
+        socket->abort();
+        socket->deleteLater();
+    }
 
     this->socket = new QTcpSocket(this);
     if(socket)
@@ -30,22 +58,45 @@ void ElmTcpSocket::connectTcp(const QString &ip, const quint16 &port)
         connect(socket,&QTcpSocket::connected,this, &ElmTcpSocket::connected);
         connect(socket,&QTcpSocket::disconnected,this,&ElmTcpSocket::disconnected);
         connect(socket,&QTcpSocket::stateChanged,this,&ElmTcpSocket::stateChange);
-//        connect(socket,&QTcpSocket::readyRead,this,&ElmTcpSocket::readyRead);
+        connect(socket,&QTcpSocket::readyRead,this,&ElmTcpSocket::readyRead);
         connect(socket,SIGNAL(error(QAbstractSocket::SocketError)),this, SLOT(socketError(QAbstractSocket::SocketError)));
+
+        // Returns at once, connected() or tcpConnectFailed() follows.
         socket->connectToHost(ip, port);
-        socket->waitForConnected(3000);
+        if(m_connectTimerId)
+            killTimer(m_connectTimerId);
+        m_connectTimerId = startTimer(CONNECT_TIMEOUT);
     }
 }
 
 void ElmTcpSocket::disconnectTcp()
 {
+    if(m_connectTimerId)
+        killTimer(m_connectTimerId);
+    m_connectTimerId = 0;
+
     if(socket)
     {
         socket->close();
         socket->deleteLater();
+        socket = nullptr;
     }
 }
 
+void ElmTcpSocket::timerEvent(QTimerEvent *event)
+{
+    // a connect timer killed after this event was queued
+    if(event->timerId() != m_connectTimerId)
+        return;
+
+    // the connect timed out
+    killTimer(m_connectTimerId);
+    m_connectTimerId = 0;
+    if(socket)
+        socket->abort();
+    emit tcpConnectFailed();
+}
+
 bool ElmTcpSocket::isConnected()
 {
     return m_connected;
@@ -54,26 +105,9 @@ bool ElmTcpSocket::isConnected()
 
 bool ElmTcpSocket::send(const QString &command)
 {
-    if(socket->isOpen())
+    if(socket && socket->isOpen())
     {
-        connect(socket,&QTcpSocket::readyRead,this,&ElmTcpSocket::readyRead);
-
-        QByteArray dataToSend = command.toUtf8();
-
-        if (command.isEmpty())
-        {
-            // If toWrite is empty then just send a CR char.
-            dataToSend += ('\r');
-        }
-        else
-        {
-            // Check for CR at end.
-            if (dataToSend[dataToSend.size()] != '\r')
-                dataToSend += '\r';
-        }
-
-        socket->write(dataToSend);
-        return socket->waitForBytesWritten();
+        return writeCommand(command);
     }
     else
         return false;
@@ -81,53 +115,166 @@ bool ElmTcpSocket::send(const QString &command)
 
 bool ElmTcpSocket::sendAsync(const QString &command)
 {
-    if(socket->isOpen())
+    if(socket && socket->isOpen())
+    {
+        return writeCommand(command);
+    }
+    else
+        return false;
+}
+
+bool ElmTcpSocket::writeCommand(const QString &command)
+{
+    // The command with its CR in one write, handed to the system right
+    // away; with Nagle off that is one segment on the wire.
+    const QByteArray &data = encode(command);
+    qint64 written = socket->write(data);
+
+    // write() only buffers, flush() is the send; what the system did not
+    // take there waits until the socket is writable again. How it is cut
+    // into segments is not visible from here.
+    socket->flush();
+    if(written == data.size() && socket->bytesToWrite() > 0)
+        m_deferredWrites++;
+
+    return written == data.size();
+}
+
+void ElmTcpSocket::setLowLatency(bool enabled)
+{
+    m_lowLatency = enabled;
+    if(socket)
+        applySocketOptions();
+}
+
+bool ElmTcpSocket::lowLatency() const
+{
+    return m_lowLatency;
+}
+
+quint64 ElmTcpSocket::deferredWrites() const
+{
+    return m_deferredWrites;
+}
+
+void ElmTcpSocket::applySocketOptions()
+{
+    // Nagle holds a small segment back until the last one is acked, and
+    // with delayed acks on the adapter side that is up to 200 ms a request.
+    socket->setSocketOption(QAbstractSocket::LowDelayOption, m_lowLatency ? 1 : 0);
+    // A dead access point shows as a drop instead of a silent socket,
+    // within about 11 s where the probe timing can be set.
+    socket->setSocketOption(QAbstractSocket::KeepAliveOption, 1);
+#if defined(Q_OS_LINUX) || defined(Q_OS_ANDROID)
+    int descriptor = static_cast<int>(socket->socketDescriptor());
+    if(descriptor >= 0)
     {
-        QByteArray dataToSend = command.toUtf8();
+        setsockopt(descriptor, IPPROTO_TCP, TCP_KEEPIDLE, &KEEPALIVE_IDLE, sizeof(KEEPALIVE_IDLE));
+        setsockopt(descriptor, IPPROTO_TCP, TCP_KEEPINTVL, &KEEPALIVE_INTERVAL, sizeof(KEEPALIVE_INTERVAL));
+        setsockopt(descriptor, IPPROTO_TCP, TCP_KEEPCNT, &KEEPALIVE_PROBES, sizeof(KEEPALIVE_PROBES));
+    }
+#endif
+    socket->setSocketOption(QAbstractSocket::SendBufferSizeSocketOption, SEND_BUFFER);
+    socket->setSocketOption(QAbstractSocket::ReceiveBufferSizeSocketOption, RECEIVE_BUFFER);
+}
 
-        if (command.isEmpty())
-        {
-            // If toWrite is empty then just send a CR char.
-            dataToSend += ('\r');
-        }
-        else
+QString ElmTcpSocket::benchmark(const QString &command, int rounds)
+{
+    if(!m_connected)
+        return QString("RTT: not connected");
+
+    bool lowLatency = m_lowLatency;
+    QString result = QString("RTT %1 to %2:%3, %4 rounds:")
+            .arg(command).arg(socket->peerName()).arg(socket->peerPort()).arg(rounds);
+
+    for(bool enabled : {false, true})
+    {
+        setLowLatency(enabled);
+
+        QVector<qint64> times;
+        times.reserve(rounds);
+        QElapsedTimer timer;
+        for(int i = 0; i < rounds && m_connected; i++)
         {
-            // Check for CR at end.
-            if (dataToSend[dataToSend.size()] != '\r')
-                dataToSend += '\r';
+            timer.start();
+            readData(command, 1000);
+            times.append(timer.nsecsElapsed());
         }
+        if(times.isEmpty())
+            break;
 
-        socket->write(dataToSend);
-        return socket->waitForBytesWritten();
+        std::sort(times.begin(), times.end());
+        result.append(QString(" %1 median %2 ms p95 %3 ms%4")
+                      .arg(enabled ? "low delay" : "Nagle")
+                      .arg(times[times.size() / 2] / 1e6, 0, 'f', 2)
+                      .arg(times[times.size() * 95 / 100] / 1e6, 0, 'f', 2)
+                      .arg(enabled ? "" : ","));
     }
-    else
-        return false;
+
+    setLowLatency(lowLatency);
+    result.append(QString(", %1 deferred writes").arg(m_deferredWrites));
+    return result;
+}
+
+const QByteArray &ElmTcpSocket::encode(const QString &command)
+{
+    // Commands are plain ASCII. Written over the last one, the buffer
+    // keeps its capacity and a request costs no allocation.
+    int size = command.size();
+    bool terminated = size > 0 && command.at(size - 1) == QChar('\r');
+
+    m_sendBuffer.resize(terminated ? size : size + 1);
+    for(int i = 0; i < size; i++)
+    {
+        m_sendBuffer[i] = command.at(i).toLatin1();
+    }
+    m_sendBuffer[m_sendBuffer.size() - 1] = '\r';
+
+    return m_sendBuffer;
+}
+
+bool ElmTcpSocket::fill()
+{
+    // straight into the framer, no buffer of our own in between
+    bool read = false;
+    while(socket->bytesAvailable() > 0)
+    {
+        int space = 0;
+        char *buffer = m_framer.writeBuffer(space);
+        qint64 count = socket->read(buffer, space);
+        if(count <= 0)
+            break;
+
+        m_framer.commit(static_cast<int>(count));
+        m_received += static_cast<quint64>(count);
+        read = true;
+    }
+    return read;
 }
 
 void ElmTcpSocket::readyRead()
 {
-    QString strData{};
-    QByteArray data = socket->readAll();
-    byteblock += data;
+    // a waiting readData takes its reply itself
+    if(m_syncRead)
+        return;
 
-    strData = QString::fromStdString(byteblock.toStdString());
+    fill();
 
-    if(strData.contains("\r"))
+    QByteArray reply;
+    while(m_framer.takeReply(reply))
     {
-        if(!strData.isEmpty())
-        {           
-            byteblock.clear();
-            if(!strData.isEmpty())
-            {
-                disconnect(socket,&QTcpSocket::readyRead,this,&ElmTcpSocket::readyRead);
-                emit dataReceived(strData);
-            }
-        }
+        emit dataReceived(reply);
     }
 }
 
 void ElmTcpSocket::connected()
 {
+    if(m_connectTimerId)
+        killTimer(m_connectTimerId);
+    m_connectTimerId = 0;
+
+    applySocketOptions();
+    m_silentExpiries = 0;
     m_connected = true;
     emit tcpConnected();
 }
@@ -138,51 +285,114 @@ void ElmTcpSocket::disconnected()
     emit tcpDisconnected();
 }
 
-QString ElmTcpSocket::checkData()
+QByteArray ElmTcpSocket::checkData()
 {
-    QString strData{};
+    QScopedValueRollback<bool> syncRead(m_syncRead, true);
 
-    if (socket->waitForReadyRead())
+    QByteArray reply;
+    if (socket && socket->waitForReadyRead() && fill() && m_framer.takeReply(reply))
     {
-        QByteArray data = socket->readAll();
-        byteblock += data;
+        emit dataReceived(reply);
+    }
+    return reply;
+}
 
-        strData = QString::fromStdString(byteblock.toStdString());
-        if(strData.contains("\r"))
-        {
-            byteblock.clear();            
-            emit dataReceived(strData);
-            return strData;
-        }
+void ElmTcpSocket::drain()
+{
+    if(!socket)
+        return;
+
+    QScopedValueRollback<bool> syncRead(m_syncRead, true);
+
+    // whatever the adapter still sends belongs to no request
+    socket->readAll();
+    while(socket->waitForReadyRead(20))
+    {
+        socket->readAll();
     }
-    return strData;
+    m_framer.clear();
 }
 
-QString ElmTcpSocket::readData(const QString &command)
+QByteArray ElmTcpSocket::readData(const QString &command, int deadline)
 {
-    QString strData{};
+    // A request started from the event loop below supersedes this one.
+    quint32 generation = ++m_generation;
+    QScopedValueRollback<bool> syncRead(m_syncRead, true);
+
+    // left over from an earlier reply, not part of this one
+    m_framer.clear();
 
     if(sendAsync(command))
     {
-        if (socket->waitForReadyRead())
-        {            
-            QByteArray data;
-            data.reserve(static_cast<qint16>(socket->bytesAvailable()));
-            data = socket->readAll();
-            byteblock += data;
+        QElapsedTimer timer;
+        timer.start();
+        quint64 received = m_received;
+
+        while(generation == m_generation)
+        {
+            // the link dropped, nothing more will come for this request
+            if(!m_connected)
+                return QByteArray();
 
-            strData = QString::fromStdString(byteblock.toStdString());
-            if(strData.contains("\r"))
+            qint64 remaining = deadline - timer.elapsed();
+            if(remaining <= 0)
             {
-                byteblock.clear();
+                abort();
 
-                disconnect(socket,&QTcpSocket::readyRead,this,&ElmTcpSocket::readyRead);
-                emit dataReceived(strData);
-                return strData;
+                // The wifi is still up but nothing comes through, and the
+                // system may not notice for long. Dropped here, the link
+                // is reconnected like any other drop.
+                m_silentExpiries = m_received == received ? m_silentExpiries + 1 : 0;
+                if(m_silentExpiries >= SILENT_EXPIRIES)
+                {
+                    emit stateChanged(QString("No answer to %1 requests, dropping the link").arg(m_silentExpiries));
+                    socket->abort();
+                    if(m_connected)
+                        disconnected();
+                    return QByteArray();
+                }
+                return QByteArrayLiteral("STOPPED");
+            }
+
+            // The reply is complete with the prompt, not the first line end.
+            // Bytes the event loop saw come in are read without waiting.
+            QByteArray reply;
+            if ((socket->bytesAvailable() > 0 || socket->waitForReadyRead(static_cast<int>(std::min<qint64>(remaining, 20)))) &&
+                    fill() && m_framer.takeReply(reply))
+            {
+                emit dataReceived(reply);
+                return reply;
             }
+            QCoreApplication::processEvents(QEventLoop::AllEvents);
         }
+
+        // preempted, the newer request already stopped the adapter
+        return QByteArrayLiteral("STOPPED");
+    }
+    return QByteArray();
+}
+
+void ElmTcpSocket::abort()
+{
+    if(!socket)
+        return;
+
+    QScopedValueRollback<bool> syncRead(m_syncRead, true);
+
+    // Any character stops the ELM, a space is ignored if it was idle already.
+    socket->write(" ");
+    socket->waitForBytesWritten(50);
+
+    QElapsedTimer timer;
+    timer.start();
+    QByteArray answer;
+    while(timer.elapsed() < 300 && !answer.contains('>'))
+    {
+        if(socket->waitForReadyRead(20))
+            answer += socket->readAll();
     }
-    return strData;
+    m_received += static_cast<quint64>(answer.size());
+    m_framer.clear();
 }
 
 QString ElmTcpSocket::statetoString(QAbstractSocket::SocketState socketState)
@@ -224,4 +434,12 @@ void ElmTcpSocket::socketError(QAbstractSocket::SocketError)
 {
     auto errorString = socket->errorString();
     emit stateChanged(errorString);
+
+    // refused or unreachable while connecting, no need to wait the timeout out
+    if(m_connectTimerId)
+    {
+        killTimer(m_connectTimerId);
+        m_connectTimerId = 0;
+        emit tcpConnectFailed();
+    }
 }
@@ -5,6 +5,7 @@
 #include <QTcpSocket>
 #include <QCoreApplication>
 #include <QThread>
+#include "elmframer.h"
 
 class ElmTcpSocket : public QThread
 {
@@ -15,19 +16,41 @@ public:
     void run();
     bool send(const QString &);
     bool sendAsync(const QString &);
-    QString readData(const QString &);
-    QString checkData();
+    QByteArray readData(const QString &, int deadline);
+    void drain();
+    void abort();
+    QByteArray checkData();
     void connectTcp(const QString &, const quint16 &);
     void disconnectTcp();
     bool isConnected();
 
+    // TCP_NODELAY, on by default; keep-alive and buffer sizes always
+    void setLowLatency(bool enabled);
+    bool lowLatency() const;
+    // commands still buffered after flush(), the socket was not writable
+    quint64 deferredWrites() const;
+    // Round trips of command with Nagle on, then off, one line of result.
+    QString benchmark(const QString &command, int rounds);
+
 private:
-    QTcpSocket *socket;
-    QByteArray byteblock{};
+    QTcpSocket *socket{};
+    ElmFramer m_framer{};
+    QByteArray m_sendBuffer{};
     QString returnedData{};
     bool m_connected{false};
     bool m_lockDataReady{false};
+    quint32 m_generation{0};
+    bool m_syncRead{false};         // readData or drain reads, not readyRead
+    int m_connectTimerId{0};
+    bool m_lowLatency{true};
+    quint64 m_deferredWrites{0};
+    quint64 m_received{0};
+    int m_silentExpiries{0};
     QString statetoString(QAbstractSocket::SocketState);
+    const QByteArray &encode(const QString &command);
+    bool fill();
+    bool writeCommand(const QString &command);
+    void applySocketOptions();
 
 public slots:
     void connected();
@@ -36,10 +59,15 @@ public slots:
     void stateChange(QAbstractSocket::SocketState);
     void socketError(QAbstractSocket::SocketError);
 signals:
-    void dataReceived(QString);
+    void dataReceived(QByteArray);
     void stateChanged(QString);
     void tcpConnected();
     void tcpDisconnected();
+    // no answer within CONNECT_TIMEOUT, or refused
+    void tcpConnectFailed();
+
+protected:
+    void timerEvent(QTimerEvent *) override;
 
 };
 
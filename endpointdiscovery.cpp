@@ -0,0 +1,142 @@
+#include "endpointdiscovery.h"
+#include "global.h"
+
+EndpointDiscovery::EndpointDiscovery(QObject *parent) :
+    QObject(parent)
+{
+}
+
+EndpointDiscovery::~EndpointDiscovery()
+{
+    stop();
+}
+
+QList<EndpointDiscovery::Endpoint> EndpointDiscovery::candidates()
+{
+    // 192.168.0.10 most clones, 192.168.4.1 esp32 builds, 10.10.100.254
+    // the hf modules in many cheap adapters
+    const QStringList hosts{"192.168.0.10", "192.168.0.11", "192.168.4.1", "192.168.1.10", "10.10.100.254"};
+    const QList<quint16> ports{35000, 23};
+
+    QList<Endpoint> endpoints;
+    for(auto &host : hosts)
+    {
+        for(auto port : ports)
+        {
+            endpoints.append(Endpoint{host, port});
+        }
+    }
+    return endpoints;
+}
+
+bool EndpointDiscovery::isBanner(const QByteArray &reply)
+{
+    // ELM327 and its clones, also STN chips, name themselves this way
+    return reply.contains('>') && (reply.contains("ELM") || reply.contains("elm"));
+}
+
+void EndpointDiscovery::start(const QList<Endpoint> &endpoints)
+{
+    stop();
+    m_elapsed.start();
+
+    for(auto &endpoint : endpoints)
+    {
+        QTcpSocket *socket = new QTcpSocket(this);
+        m_probes.insert(socket, Probe{endpoint, QByteArray()});
+
+        connect(socket, &QTcpSocket::connected, this, &EndpointDiscovery::probeConnected);
+        connect(socket, &QTcpSocket::readyRead, this, &EndpointDiscovery::probeReadyRead);
+        connect(socket, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(probeError(QAbstractSocket::SocketError)));
+        socket->connectToHost(endpoint.ip, endpoint.port);
+    }
+
+    emit stateChanged(QString("Searching %1 wifi endpoints").arg(endpoints.size()));
+    m_timerId = startTimer(TIMEOUT);
+}
+
+void EndpointDiscovery::stop()
+{
+    if(m_timerId)
+        killTimer(m_timerId);
+    m_timerId = 0;
+
+    for(auto socket : m_probes.keys())
+    {
+        drop(socket);
+    }
+}
+
+bool EndpointDiscovery::isRunning() const
+{
+    return m_timerId != 0;
+}
+
+void EndpointDiscovery::probeConnected()
+{
+    auto socket = qobject_cast<QTcpSocket *>(sender());
+    if(!socket || !m_probes.contains(socket))
+        return;
+
+    socket->write(GET_ELM_INFO.toLatin1() + '\r');
+}
+
+void EndpointDiscovery::probeReadyRead()
+{
+    auto socket = qobject_cast<QTcpSocket *>(sender());
+    if(!socket || !m_probes.contains(socket))
+        return;
+
+    Probe &probe = m_probes[socket];
+    probe.reply += socket->readAll();
+    if(!isBanner(probe.reply))
+        return;
+
+    Endpoint endpoint = probe.endpoint;
+    QString banner = QString::fromLatin1(probe.reply);
+    banner.remove(GET_ELM_INFO).remove("\r").remove(">");
+    banner = banner.trimmed();
+
+    emit stateChanged(QString("Found %1 at %2:%3 in %4 ms")
+                      .arg(banner).arg(endpoint.ip).arg(endpoint.port).arg(m_elapsed.elapsed()));
+
+    // the adapter takes one client, the winner is let go as well
+    stop();
+    emit found(endpoint.ip, endpoint.port, banner);
+}
+
+void EndpointDiscovery::probeError(QAbstractSocket::SocketError)
+{
+    auto socket = qobject_cast<QTcpSocket *>(sender());
+    if(!socket || !m_probes.contains(socket))
+        return;
+
+    drop(socket);
+    if(m_probes.isEmpty())
+        finish();
+}
+
+void EndpointDiscovery::timerEvent(QTimerEvent *event)
+{
+    Q_UNUSED(event)
+
+    finish();
+}
+
+void EndpointDiscovery::drop(QTcpSocket *socket)
+{
+    m_probes.remove(socket);
+    socket->disconnect(this);
+    socket->abort();
+    socket->deleteLater();
+}
+
+void EndpointDiscovery::finish()
+{
+    if(!isRunning())
+        return;
+
+    stop();
+    emit stateChanged(QString("No wifi adapter answered in %1 ms").arg(m_elapsed.elapsed()));
+    emit failed();
+}
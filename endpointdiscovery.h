@@ -0,0 +1,65 @@
+#ifndef ENDPOINTDISCOVERY_H
+#define ENDPOINTDISCOVERY_H
+
+#include <QObject>
+#include <QTcpSocket>
+#include <QElapsedTimer>
+
+// Finds a wifi adapter when the saved address does not answer. Every
+// candidate is connected at once and sent ATI; the first one answering
+// with an ELM banner wins and the others are dropped, so the search takes
+// as long as the fastest adapter, at most TIMEOUT. Nothing blocks, the
+// result comes as a signal.
+class EndpointDiscovery : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Endpoint
+    {
+        QString ip;
+        quint16 port;
+    };
+
+    static const int TIMEOUT = 3000;    // ms for the whole search
+
+    explicit EndpointDiscovery(QObject *parent = nullptr);
+    ~EndpointDiscovery() override;
+
+    // Addresses the common wifi adapters come with, on 35000 and telnet.
+    static QList<Endpoint> candidates();
+    static bool isBanner(const QByteArray &reply);
+
+    void start(const QList<Endpoint> &endpoints);
+    void stop();
+    bool isRunning() const;
+
+signals:
+    void found(QString ip, quint16 port, QString banner);
+    void failed();
+    void stateChanged(QString);
+
+private slots:
+    void probeConnected();
+    void probeReadyRead();
+    void probeError(QAbstractSocket::SocketError);
+
+protected:
+    void timerEvent(QTimerEvent *) override;
+
+private:
+    struct Probe
+    {
+        Endpoint endpoint;
+        QByteArray reply;
+    };
+
+    void drop(QTcpSocket *socket);
+    void finish();
+
+    QHash<QTcpSocket *, Probe> m_probes{};
+    QElapsedTimer m_elapsed{};
+    int m_timerId{0};
+};
+
+#endif // ENDPOINTDISCOVERY_H
@@ -0,0 +1,209 @@
+#include "fuelconsumption.h"
+#include "global.h"
+
+namespace
+{
+const double STOICHIOMETRIC_AFR = 14.7;         // gasoline
+const double FUEL_DENSITY = 740.0;              // g/L, gasoline
+const double AIR_GAS_CONSTANT = 287.058;        // J/(kg K)
+const double MIN_DISTANCE = 0.1;                // km
+const qint64 MAX_INTEGRATION_GAP = 5000;        // ms
+}
+
+void CompensatedSum::add(double value)
+{
+    double sum = m_sum + value;
+    if (std::abs(m_sum) >= std::abs(value))
+        m_compensation += (m_sum - sum) + value;
+    else
+        m_compensation += (value - sum) + m_sum;
+    m_sum = sum;
+}
+
+double CompensatedSum::value() const
+{
+    return m_sum + m_compensation;
+}
+
+void CompensatedSum::clear()
+{
+    m_sum = 0.0;
+    m_compensation = 0.0;
+}
+
+FuelConsumption::FuelConsumption()
+{
+}
+
+FuelConsumption::Model FuelConsumption::selectModel(const std::function<bool(quint8)> &pidAvailable, bool pidsChecked)
+{
+    bool speedDensity = m_displacement > 0.0;
+
+    if(!pidsChecked)
+    {
+        // Without a pid search, MAP/RPM/IAT is the set nearly every ECU answers.
+        m_model = speedDensity ? SpeedDensity : Maf;
+    }
+    else if(pidAvailable(0x5E))
+        m_model = FuelRate;
+    else if(pidAvailable(0x10))
+        m_model = Maf;
+    else if(speedDensity && pidAvailable(0x0B) && pidAvailable(0x0C) && pidAvailable(0x0F))
+        m_model = SpeedDensity;
+    else
+        m_model = None;
+
+    return m_model;
+}
+
+FuelConsumption::Model FuelConsumption::model() const
+{
+    return m_model;
+}
+
+QString FuelConsumption::modelName() const
+{
+    switch (m_model)
+    {
+    case FuelRate:
+        return "Fuel rate";
+    case Maf:
+        return "MAF";
+    case SpeedDensity:
+        return "Speed density";
+    default:
+        return "None";
+    }
+}
+
+QStringList FuelConsumption::requiredCommands() const
+{
+    switch (m_model)
+    {
+    case FuelRate:
+        return {FUEL_RATE, VEHICLE_SPEED};
+    case Maf:
+        return {MAF_AIR_FLOW, VEHICLE_SPEED};
+    case SpeedDensity:
+        return {MAN_ABSOLUTE_PRESSURE, INTAKE_AIR_TEMP, ENGINE_RPM, VEHICLE_SPEED};
+    default:
+        return {};
+    }
+}
+
+std::vector<int> FuelConsumption::inputs() const
+{
+    return {CH_FUEL_RATE, CH_MAF_AIR_FLOW, CH_MAN_ABSOLUTE_PRESSURE, CH_INTAKE_AIR_TEMP, CH_ENGINE_RPM};
+}
+
+void FuelConsumption::setDisplacement(unsigned int cc)
+{
+    m_displacement = cc / 1000.0;
+}
+
+void FuelConsumption::setVolumetricEfficiency(double value)
+{
+    m_volumetricEfficiency = value;
+}
+
+bool FuelConsumption::fuelRate(const std::function<bool(int, double &)> &channel, double &litresPerHour) const
+{
+    double airFlow = 0.0;   // g/s
+
+    switch (m_model)
+    {
+    case FuelRate:
+        return channel(CH_FUEL_RATE, litresPerHour);
+    case Maf:
+        if(!channel(CH_MAF_AIR_FLOW, airFlow))
+            return false;
+        break;
+    case SpeedDensity:
+    {
+        double map = 0.0, iat = 0.0, rpm = 0.0;
+        if(!channel(CH_MAN_ABSOLUTE_PRESSURE, map) || !channel(CH_INTAKE_AIR_TEMP, iat) || !channel(CH_ENGINE_RPM, rpm))
+            return false;
+
+        // ideal gas: m = p V / (R T), one intake stroke every two revolutions
+        double volumeFlow = m_displacement / 1000.0 * m_volumetricEfficiency * rpm / 120.0;    // m3/s
+        airFlow = map * 1000.0 * volumeFlow / (AIR_GAS_CONSTANT * (iat + 273.15)) * 1000.0;
+        break;
+    }
+    default:
+        return false;
+    }
+
+    litresPerHour = airFlow * 3600.0 / (STOICHIOMETRIC_AFR * FUEL_DENSITY);
+    return true;
+}
+
+void FuelConsumption::integrate(double litresPerHour, double speed, qint64 timestamp)
+{
+    qint64 dt = timestamp - m_lastTimestamp;
+
+    // Rates hold until the next sample arrives; long gaps are not integrated.
+    if(m_lastTimestamp != 0 && dt > 0 && dt <= MAX_INTEGRATION_GAP)
+    {
+        double fuel = m_lastRate * dt / 3600000.0;
+        double distance = m_lastSpeed * dt / 3600000.0;
+
+        m_tripFuel.add(fuel);
+        m_tripDistance.add(distance);
+
+        m_window.push_back(Step{timestamp, fuel, distance});
+        m_windowFuel.add(fuel);
+        m_windowDistance.add(distance);
+
+        while(!m_window.empty() && timestamp - m_window.front().timestamp > m_windowLength)
+        {
+            m_windowFuel.add(-m_window.front().fuel);
+            m_windowDistance.add(-m_window.front().distance);
+            m_window.pop_front();
+        }
+    }
+
+    if(dt > 0 || m_lastTimestamp == 0)
+        m_lastTimestamp = timestamp;
+    m_lastRate = litresPerHour;
+    m_lastSpeed = speed;
+}
+
+void FuelConsumption::resetTrip()
+{
+    m_tripFuel.clear();
+    m_tripDistance.clear();
+    m_window.clear();
+    m_windowFuel.clear();
+    m_windowDistance.clear();
+    m_lastTimestamp = 0;
+    m_lastRate = 0.0;
+    m_lastSpeed = 0.0;
+}
+
+double FuelConsumption::tripFuel() const
+{
+    return m_tripFuel.value();
+}
+
+double FuelConsumption::tripDistance() const
+{
+    return m_tripDistance.value();
+}
+
+bool FuelConsumption::tripAverage(double &litresPer100km) const
+{
+    if(m_tripDistance.value() < MIN_DISTANCE)
+        return false;
+
+    litresPer100km = m_tripFuel.value() / m_tripDistance.value() * 100.0;
+    return true;
+}
+
+bool FuelConsumption::windowAverage(double &litresPer100km) const
+{
+    if(m_windowDistance.value() < MIN_DISTANCE)
+        return false;
+
+    litresPer100km = m_windowFuel.value() / m_windowDistance.value() * 100.0;
+    return true;
+}
@@ -0,0 +1,79 @@
+#ifndef FUELCONSUMPTION_H
+#define FUELCONSUMPTION_H
+
+#include <QtCore>
+#include <deque>
+#include <functional>
+
+// Kahan-Babuska compensated sum, so hours of small increments do not drift.
+class CompensatedSum
+{
+public:
+    void add(double value);
+    double value() const;
+    void clear();
+
+private:
+    double m_sum{0.0};
+    double m_compensation{0.0};
+};
+
+// Streaming fuel model. The source is chosen once from the supported PIDs:
+// PID 5E fuel rate, then MAF (PID 10), then speed-density from MAP, IAT,
+// RPM and the stored engine displacement.
+class FuelConsumption
+{
+public:
+    enum Model {None, FuelRate, Maf, SpeedDensity};
+
+    FuelConsumption();
+
+    Model selectModel(const std::function<bool(quint8)> &pidAvailable, bool pidsChecked);
+    Model model() const;
+    QString modelName() const;
+
+    // Service 01 commands this model needs, speed included.
+    QStringList requiredCommands() const;
+    // Channels the fuel rate is computed from.
+    std::vector<int> inputs() const;
+
+    void setDisplacement(unsigned int cc);
+    void setVolumetricEfficiency(double value);
+
+    // L/h from the current channel values, false if an input is missing.
+    bool fuelRate(const std::function<bool(int, double &)> &channel, double &litresPerHour) const;
+
+    void integrate(double litresPerHour, double speed, qint64 timestamp);
+    void resetTrip();
+
+    double tripFuel() const;                // L
+    double tripDistance() const;            // km
+    bool tripAverage(double &litresPer100km) const;
+    bool windowAverage(double &litresPer100km) const;
+
+private:
+    struct Step
+    {
+        qint64 timestamp;
+        double fuel;
+        double distance;
+    };
+
+    Model m_model{None};
+    double m_displacement{0.0};             // L
+    double m_volumetricEfficiency{0.85};
+
+    CompensatedSum m_tripFuel{};
+    CompensatedSum m_tripDistance{};
+
+    std::deque<Step> m_window{};
+    CompensatedSum m_windowFuel{};
+    CompensatedSum m_windowDistance{};
+    qint64 m_windowLength{60000};           // ms
+
+    qint64 m_lastTimestamp{0};
+    double m_lastRate{0.0};
+    double m_lastSpeed{0.0};
+};
+
+#endif // FUELCONSUMPTION_H
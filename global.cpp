@@ -1,3 +0,0 @@
-#include "global.h"
-QStringList runtimeCommands = {};  // initialize
-int interval = 500;
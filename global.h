@@ -3,8 +3,6 @@
 #include <QMainWindow>
 #include <QtCore>
 #include <QVector>
-extern QStringList runtimeCommands;
-extern int interval;
 
 static std::string ERROR[] = {
     "ACT ALERT",
@@ -41,8 +39,12 @@ ALLOW_LONG_MESSAGE = "ATAL",
 VOLTAGE = "ATRV",
 GET_PP_SUMMARY= "ATPPS",
 GET_ELM_INFO = "ATI",
+GET_DEVICE_DESCRIPTION = "AT@1",
 PROTOCOL_AUTO = "ATSP0",
 GET_PROTOCOL = "ATDP",
+GET_PROTOCOL_NUMBER = "ATDPN",
+SET_PROTOCOL = "ATSP",   // + protocol number, A prefix for auto search after it
+TRY_PROTOCOL = "ATTP",
 PROTOCOL_SEARCH_ORDER= "ATSS",
 ECHO_OFF = "ATE0",
 ECHO_ON = "ATE1",
@@ -52,11 +54,14 @@ HEADERS_OFF = "ATH0",
 HEADERS_ON = "ATH1",
 SPACES_OFF = "ATS0",
 SPACES_ON = "ATS1",
+FORMATTING_ON = "ATCAF1",
 ADAPTIF_TIMING_OFF = "ATAT0",
 ADAPTIF_TIMING_AUTO1 = "ATAT1",
 ADAPTIF_TIMING_AUTO2 = "ATAT2",
 TIMEOUT_DEFAULT = "ATSTFF",
 TERMINATE_SESSION = "ATPC",
+LOW_POWER = "ATLP",
+VEHICLE_ID = "0902", //VIN, 17 ascii characters
 PIDS_SUPPORTED20 = "0100", //PIDs supported [01 - 20]
 PIDS_SUPPORTED40 = "0120", //PIDs supported [21 - 40]
 PIDS_SUPPORTED60 = "0140", //PIDs supported [41 - 60]
@@ -92,6 +97,59 @@ PROTOCOL_ISO_9141_2 = "ATSP3";
 
 //0104, 0105, 010B, 010C, 010D, 010F, 0110, 0111, 011C
 
+// Channel ids shared by the decode path and its consumers.
+// Service 01 values keep their PID number, everything else lives above 0xFF.
+enum ObdChannel
+{
+    CH_ENGINE_LOAD = 0x04,              // %
+    CH_COOLANT_TEMP = 0x05,             // C
+    CH_MAN_ABSOLUTE_PRESSURE = 0x0B,    // kPa
+    CH_ENGINE_RPM = 0x0C,               // rpm
+    CH_VEHICLE_SPEED = 0x0D,            // km/h
+    CH_INTAKE_AIR_TEMP = 0x0F,          // C
+    CH_MAF_AIR_FLOW = 0x10,             // g/s
+    CH_BAROMETRIC_PRESSURE = 0x33,      // kPa
+    CH_FUEL_RATE = 0x5E,                // L/h
+    CH_VOLTAGE = 0x100,                 // V, ATRV
+    CH_GPS_BAROMETRIC_PRESSURE,         // kPa, from gps altitude
+    CH_AMBIENT_PRESSURE,                // kPa, PID 33 or gps
+    CH_BOOST,                           // psi
+    CH_FUEL_FLOW,                       // L/h
+    CH_INSTANT_CONSUMPTION,             // L/100km
+    CH_TRIP_FUEL,                       // L
+    CH_AVERAGE_CONSUMPTION,             // L/100km, whole trip
+    CH_WINDOW_CONSUMPTION,              // L/100km, rolling window
+    CH_ENGINE_POWER,                    // kW
+    CH_COUNT
+};
+
+static QString channelName(int channel)
+{
+    switch (channel)
+    {
+    case CH_ENGINE_LOAD: return QLatin1String("Engine load");
+    case CH_COOLANT_TEMP: return QLatin1String("Coolant");
+    case CH_MAN_ABSOLUTE_PRESSURE: return QLatin1String("Map");
+    case CH_ENGINE_RPM: return QLatin1String("Rpm");
+    case CH_VEHICLE_SPEED: return QLatin1String("Speed");
+    case CH_INTAKE_AIR_TEMP: return QLatin1String("Intake air");
+    case CH_MAF_AIR_FLOW: return QLatin1String("Maf");
+    case CH_BAROMETRIC_PRESSURE: return QLatin1String("Barometric");
+    case CH_FUEL_RATE: return QLatin1String("Fuel rate");
+    case CH_VOLTAGE: return QLatin1String("Voltage");
+    case CH_GPS_BAROMETRIC_PRESSURE: return QLatin1String("Gps barometric");
+    case CH_AMBIENT_PRESSURE: return QLatin1String("Ambient pressure");
+    case CH_BOOST: return QLatin1String("Boost");
+    case CH_FUEL_FLOW: return QLatin1String("Fuel flow");
+    case CH_INSTANT_CONSUMPTION: return QLatin1String("Consumption");
+    case CH_TRIP_FUEL: return QLatin1String("Trip fuel");
+    case CH_AVERAGE_CONSUMPTION: return QLatin1String("Average consumption");
+    case CH_WINDOW_CONSUMPTION: return QLatin1String("Window consumption");
+    case CH_ENGINE_POWER: return QLatin1String("Power");
+    default: return QString("Pid %1").arg(channel, 2, 16, QLatin1Char('0')).toUpper();
+    }
+}
+
 template <typename T>
 typename std::enable_if<std::is_unsigned<T>::value, int>::type
 inline constexpr signum(T x) {
@@ -104,7 +162,8 @@ inline constexpr signum(T x) {
     return (T(0) < x) - (x < T(0));
 }
 
-static QStringList initializeCommands{LINEFEED_OFF, ECHO_OFF, HEADERS_OFF, ADAPTIF_TIMING_AUTO2, PROTOCOL_ISO_9141_2, MONITOR_STATUS};
+// The protocol is not part of it, ProtocolDetector finds it per vehicle.
+static QStringList initializeCommands{LINEFEED_OFF, ECHO_OFF, HEADERS_OFF, ADAPTIF_TIMING_AUTO2, MONITOR_STATUS};
 
 static long long currentTimeMillis()
 {
@@ -0,0 +1,91 @@
+#include "heatmapwidget.h"
+#include <QPainter>
+#include <QPaintEvent>
+#include <cmath>
+
+HeatmapWidget::HeatmapWidget(QWidget *parent) :
+    QWidget(parent)
+{
+    setAttribute(Qt::WA_OpaquePaintEvent);
+    setMinimumHeight(120);
+}
+
+void HeatmapWidget::setMap(const OperatingPointMap *map)
+{
+    m_map = map;
+    rebuild();
+}
+
+void HeatmapWidget::setTitle(const QString &title)
+{
+    m_title = title;
+    update();
+}
+
+void HeatmapWidget::updateCell(int column, int row)
+{
+    if(!m_map || m_image.isNull())
+        return;
+
+    // Doubling the scale keeps the full rebuilds logarithmic in trip length.
+    double seconds = m_map->cell(column, row);
+    if(seconds > m_scale)
+    {
+        m_scale = seconds * 2.0;
+        rebuild();
+        return;
+    }
+
+    m_image.setPixel(column, m_map->rows() - 1 - row, color(seconds));
+    update();
+}
+
+void HeatmapWidget::rebuild()
+{
+    if(!m_map)
+        return;
+
+    if(m_image.width() != m_map->columns() || m_image.height() != m_map->rows())
+        m_image = QImage(m_map->columns(), m_map->rows(), QImage::Format_RGB32);
+
+    m_scale = std::max(1.0, m_map->maximum() * 2.0);
+
+    for(int row = 0; row < m_map->rows(); row++)
+    {
+        for(int column = 0; column < m_map->columns(); column++)
+        {
+            m_image.setPixel(column, m_map->rows() - 1 - row, color(m_map->cell(column, row)));
+        }
+    }
+    update();
+}
+
+void HeatmapWidget::paintEvent(QPaintEvent *event)
+{
+    Q_UNUSED(event)
+
+    QPainter painter(this);
+    if(m_image.isNull())
+    {
+        painter.fillRect(rect(), m_background);
+        return;
+    }
+
+    painter.drawImage(rect(), m_image);
+
+    if(!m_title.isEmpty())
+    {
+        painter.setPen(Qt::white);
+        painter.drawText(rect().adjusted(6, 4, -6, -4), Qt::AlignLeft | Qt::AlignTop, m_title);
+    }
+}
+
+QRgb HeatmapWidget::color(double seconds) const
+{
+    if(seconds <= 0.0)
+        return m_background.rgb();
+
+    // log scale, short visits stay visible next to hours of cruising
+    double ratio = std::min(1.0, std::log1p(seconds) / std::log1p(m_scale));
+    return QColor::fromHsvF((1.0 - ratio) * 0.66, 1.0, 0.35 + 0.65 * ratio).rgb();
+}
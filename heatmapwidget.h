@@ -0,0 +1,39 @@
+#ifndef HEATMAPWIDGET_H
+#define HEATMAPWIDGET_H
+
+#include <QWidget>
+#include <QImage>
+#include <QColor>
+#include "operatingpointmap.h"
+
+// Draws an OperatingPointMap. The image holds one pixel per cell and is
+// scaled when painted, so a new sample only recolours its own cell; the
+// whole image is rebuilt only when the colour scale has to grow.
+class HeatmapWidget : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit HeatmapWidget(QWidget *parent = nullptr);
+
+    void setMap(const OperatingPointMap *map);
+    void setTitle(const QString &title);
+
+public slots:
+    void updateCell(int column, int row);
+    void rebuild();
+
+protected:
+    void paintEvent(QPaintEvent *) override;
+
+private:
+    QRgb color(double seconds) const;
+
+    const OperatingPointMap *m_map{};
+    QImage m_image{};
+    QString m_title{};
+    double m_scale{1.0};            // seconds drawn at full colour
+    QColor m_background{"#001a1a"};
+};
+
+#endif // HEATMAPWIDGET_H
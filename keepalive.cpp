@@ -0,0 +1,105 @@
+#include "keepalive.h"
+#include "global.h"
+
+const int WAKEUP_INTERVAL = 0x62;       // ATSW units of 20.48 ms, about 2 s
+const qint64 PING_IDLE = 3500;          // ms, below the 5 s P3 limit
+const qint64 LINGER = 15000;            // ms after the last consumer left
+
+// KWP keeps its session with tester present, ISO 9141 with the ELM default
+const QString KWP_WAKEUP_MESSAGE = "ATWMC133F13E";
+const QString ISO_WAKEUP_MESSAGE = "ATWM686AF10100";
+
+KeepAlive::KeepAlive()
+{
+}
+
+void KeepAlive::reset()
+{
+    m_protocol.clear();
+    m_released = 0;
+    m_lastActivity = 0;
+    m_active = false;
+}
+
+void KeepAlive::setProtocol(const QString &protocol)
+{
+    if(protocol == m_protocol)
+        return;
+
+    m_protocol = protocol;
+    // sent again for the new bus on the next poll
+    m_active = false;
+}
+
+bool KeepAlive::isSlowInit() const
+{
+    return m_protocol == "3" || m_protocol == "4" || m_protocol == "5";
+}
+
+void KeepAlive::subscribe(qint64 timestamp)
+{
+    m_subscribers++;
+    m_lastActivity = std::max(m_lastActivity, timestamp);
+}
+
+void KeepAlive::unsubscribe(qint64 timestamp)
+{
+    if(m_subscribers == 0)
+        return;
+
+    m_subscribers--;
+    if(m_subscribers == 0)
+        m_released = timestamp;
+}
+
+int KeepAlive::subscribers() const
+{
+    return m_subscribers;
+}
+
+void KeepAlive::activity(qint64 timestamp)
+{
+    m_lastActivity = timestamp;
+}
+
+QStringList KeepAlive::poll(qint64 timestamp, bool parked)
+{
+    QStringList commands;
+    if(!isSlowInit())
+        return commands;
+
+    bool wanted = this->wanted(timestamp) && !parked;
+    if(wanted && !m_active)
+    {
+        commands.append(m_protocol == "3" ? ISO_WAKEUP_MESSAGE : KWP_WAKEUP_MESSAGE);
+        commands.append(QString("ATSW%1").arg(WAKEUP_INTERVAL, 2, 16, QLatin1Char('0')).toUpper());
+        m_active = true;
+    }
+    else if(!wanted && m_active)
+    {
+        commands.append("ATSW00");
+        m_active = false;
+    }
+
+    if(wanted && timestamp - m_lastActivity >= PING_IDLE)
+    {
+        commands.append(PIDS_SUPPORTED20);
+        m_lastActivity = timestamp;
+        m_pings++;
+    }
+
+    return commands;
+}
+
+quint64 KeepAlive::pings() const
+{
+    return m_pings;
+}
+
+bool KeepAlive::wanted(qint64 timestamp) const
+{
+    if(m_subscribers > 0)
+        return true;
+
+    return m_released > 0 && timestamp - m_released < LINGER;
+}
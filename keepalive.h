@@ -0,0 +1,49 @@
+#ifndef KEEPALIVE_H
+#define KEEPALIVE_H
+
+#include <QtCore>
+
+// Keeps an ISO 9141-2 or KWP session open while someone polls. These buses
+// drop the session after about 5 s without traffic and the next request
+// pays the slow init again, 2 to 3 s with the 5 baud one. While a consumer
+// is subscribed the ELM sends its wakeup message every ATSW interval; a
+// request of our own goes out when the poll loop itself has been quiet
+// too long, for adapters that do not keep to ATSW. A short linger after
+// the last consumer covers switching between screens, then ATSW00 lets
+// the bus sleep. CAN and J1850 need none of this.
+class KeepAlive
+{
+public:
+    KeepAlive();
+
+    void reset();
+    // ATDPN number without the auto prefix
+    void setProtocol(const QString &protocol);
+    bool isSlowInit() const;
+
+    void subscribe(qint64 timestamp);
+    void unsubscribe(qint64 timestamp);
+    int subscribers() const;
+
+    // Any request on the bus counts as traffic.
+    void activity(qint64 timestamp);
+
+    // Returns the commands to send now: ATSW and ATWM when the session
+    // should change, or the idle ping. Nothing while parked, the engine
+    // off has no session worth keeping.
+    QStringList poll(qint64 timestamp, bool parked);
+
+    quint64 pings() const;
+
+private:
+    bool wanted(qint64 timestamp) const;
+
+    QString m_protocol{};
+    int m_subscribers{0};
+    qint64 m_released{0};
+    qint64 m_lastActivity{0};
+    bool m_active{false};
+    quint64 m_pings{0};
+};
+
+#endif // KEEPALIVE_H
@@ -63,7 +63,7 @@ MainWindow::MainWindow(QWidget *parent) :
         ui->textTerminal->append("Wifi Ip: " + m_settingsManager->getWifiIp() + " : " + QString::number(m_settingsManager->getWifiPort()));
     }
 
-    elm = new ELM();
+    elm = ELM::getInstance();
     elm->resetPids();
 
     m_connectionManager = ConnectionManager::getInstance();
@@ -71,6 +71,7 @@ MainWindow::MainWindow(QWidget *parent) :
     {
         connect(m_connectionManager,&ConnectionManager::connected,this, &MainWindow::connected);
         connect(m_connectionManager,&ConnectionManager::disconnected,this,&MainWindow::disconnected);
+        connect(m_connectionManager,&ConnectionManager::resumed,this,&MainWindow::resumed);
         connect(m_connectionManager,&ConnectionManager::dataReceived,this,&MainWindow::dataReceived);       
         connect(m_connectionManager, &ConnectionManager::stateChanged, this, &MainWindow::stateChanged);
 
@@ -112,6 +113,10 @@ MainWindow::MainWindow(QWidget *parent) :
 
 MainWindow::~MainWindow()
 {
+    TripDetector::getInstance()->finishTrip(currentTimeMillis());
+    delete m_sessionPool;
+    delete m_proxy;
+
     if(m_connectionManager)
     {
         m_connectionManager->disConnectElm();
@@ -204,9 +209,106 @@ void MainWindow::on_pushExit_clicked()
 void MainWindow::on_pushSend_clicked()
 {
     QString command = ui->sendEdit->text();
+
+    // '#' commands are answered here, the adapter never sees them
+    if(command.startsWith("#"))
+    {
+        localCommand(command.trimmed().toUpper());
+        return;
+    }
+
     send(command);
 }
 
+void MainWindow::localCommand(const QString &command)
+{
+    if(command == "#STATS")
+    {
+        ui->textTerminal->append(m_connectionManager->wireStatistics().summary());
+        ui->textTerminal->append(m_connectionManager->recovery().summary());
+        ui->textTerminal->append("Keep-alive pings: " + QString::number(m_connectionManager->keepAlive().pings()));
+    }
+    else if(command == "#BENCH")
+    {
+        ui->textTerminal->append(ElmSanitizer::benchmark(10000));
+    }
+    else if(command == "#ALLOC")
+    {
+        ui->textTerminal->append(AllocationCounter::benchmark(10000));
+    }
+    else if(command == "#FRAMER")
+    {
+        ui->textTerminal->append(ElmFramer::benchmark(100000));
+    }
+    else if(command == "#RTT")
+    {
+        m_reading = true;
+        ui->textTerminal->append(m_connectionManager->rttBenchmark(200));
+        m_reading = false;
+    }
+    else if(command.startsWith("#SESSIONS"))
+    {
+        // "#SESSIONS ip:port ip:port" polls more adapters on threads of
+        // their own, "#SESSIONS" shows their rates, "#SESSIONS STOP" ends them.
+        if(!m_sessionPool)
+        {
+            m_sessionPool = new ElmSessionPool(this);
+            connect(m_sessionPool, &ElmSessionPool::stateChanged, this, &MainWindow::stateChanged);
+        }
+
+        QStringList arguments = command.split(' ', QString::SkipEmptyParts).mid(1);
+        if(arguments == QStringList{"STOP"})
+        {
+            for(auto &line : m_sessionPool->summary())
+            {
+                ui->textTerminal->append(line);
+            }
+            m_sessionPool->stop();
+        }
+        else if(!arguments.isEmpty())
+        {
+            m_sessionPool->start(arguments);
+        }
+        else
+        {
+            for(auto &line : m_sessionPool->summary())
+            {
+                ui->textTerminal->append(line);
+            }
+        }
+    }
+    else if(command.startsWith("#PROXY"))
+    {
+        // "#PROXY [port]" shares the adapter with other tools on this
+        // machine, "#PROXY STATS" counts merged requests, "#PROXY STOP".
+        if(!m_proxy)
+        {
+            m_proxy = new ElmProxyServer(m_connectionManager, this);
+            connect(m_proxy, &ElmProxyServer::stateChanged, this, &MainWindow::stateChanged);
+        }
+
+        QStringList arguments = command.split(' ', QString::SkipEmptyParts).mid(1);
+        if(arguments == QStringList{"STOP"})
+        {
+            ui->textTerminal->append(m_proxy->summary());
+            m_proxy->close();
+        }
+        else if(arguments == QStringList{"STATS"})
+        {
+            ui->textTerminal->append(m_proxy->summary());
+        }
+        else
+        {
+            quint16 port = arguments.isEmpty() ? ElmProxyServer::DEFAULT_PORT : static_cast<quint16>(arguments.first().toUInt());
+            m_proxy->listen(port);
+        }
+    }
+    else
+    {
+        ui->textTerminal->append("Unknown command " + command + ", try #STATS, #BENCH, #ALLOC, #FRAMER, #RTT, #SESSIONS or #PROXY");
+    }
+}
+
 void MainWindow::on_pushClear_clicked()
 {
     ui->textTerminal->clear();
@@ -217,25 +319,68 @@ void MainWindow::connected()
     ui->pushConnect->setStyleSheet("font-size: 22pt; font-weight: bold; color: white;background-color:#154360; padding: 24px; spacing: 24px;");   
     ui->pushConnect->setText(QString("Disconnect"));
 
-    commandOrder = 0;
     m_initialized = false;
     m_connected = true;
-    interval = ui->intervalEdit->text().toInt();
+    m_connectionManager->setPollInterval(ui->intervalEdit->text().toInt());
 
     ui->textTerminal->append("Elm 327 connected");
-    send(RESET);
+
+    // answers are shown here, not by dataReceived
+    m_reading = true;
+    bool ready = m_connectionManager->initializeAdapter();
+
+    ui->textTerminal->append(m_connectionManager->initializer().summary());
+    ui->textTerminal->append(m_connectionManager->protocolDetector().summary());
+    if(!ready)
+        ui->textTerminal->append("Error : adapter did not accept every setting");
+
+    m_initialized = true;
+
+    // the init list ends with obd requests, their answers are shown as before
+    for(auto &command : initializeCommands)
+    {
+        if(command.startsWith("AT"))
+            continue;
+
+        ui->textTerminal->append("-> " + command);
+        auto data = getData(command);
+        ui->textTerminal->append("<- " + data);
+        if(data != "error")
+            analysData(data);
+    }
+    m_reading = false;
+
+    if(m_searchPidsEnable)
+    {
+        getPids();
+    }
 }
 
 void MainWindow::disconnected()
 {  
+    m_connected = false;
+
+    // the button stays on Disconnect, it stops the reconnect attempts
+    if(m_connectionManager->isReconnecting())
+    {
+        ui->textTerminal->append("Elm link lost");
+        return;
+    }
+
     ui->pushConnect->setText(QString("Connect"));
-    commandOrder = 0;
     m_initialized = false;
-    m_connected = false;
     ui->textTerminal->append("Elm DisConnected");
 
 }
 
+void MainWindow::resumed()
+{
+    // pids and poll plan are those of before, the views pick up polling
+    m_connected = true;
+    ui->textTerminal->append(QString("Elm link back after %1 ms").arg(m_connectionManager->lastOutage()));
+    ui->textTerminal->append(m_connectionManager->initializer().summary());
+}
+
 void MainWindow::analysData(const QString &dataReceived)
 {
     unsigned A = 0;
@@ -298,50 +443,34 @@ void MainWindow::analysData(const QString &dataReceived)
     }
 }
 
-void MainWindow::dataReceived(QString dataReceived)
+void MainWindow::dataReceived(QByteArray dataReceived)
 {
     if(m_reading)
         return;
 
-    dataReceived.remove("\r");
-    dataReceived.remove(">");
-    dataReceived.remove("?");
-    dataReceived.remove(",");
+    quint32 flags = 0;
+    auto data = QString::fromLatin1(ElmSanitizer::clean(dataReceived, &flags));
 
-    if(isError(dataReceived.toUpper().toStdString()))
-    {
-        ui->textTerminal->append("Error : " + dataReceived);
-    }
-    else if (!dataReceived.isEmpty())
-    {
-        ui->textTerminal->append("<- " + dataReceived);
-    }
+    // the terminal shows the reply as it came, one line
+    QString text = QString::fromLatin1(dataReceived);
+    text.remove("\r");
+    text.remove(">");
 
-    if(!m_initialized && initializeCommands.size() == commandOrder)
+    if(flags & ElmSanitizer::Error)
     {
-        commandOrder = 0;
-        m_initialized = true;        
-
-        if(m_searchPidsEnable)
-        {
-            getPids();
-        }
+        ui->textTerminal->append("Error : " + text);
     }
-    else if(!m_initialized && commandOrder < initializeCommands.size())
+    else if (!text.isEmpty())
     {
-        send(initializeCommands[commandOrder]);
-        commandOrder++;
+        ui->textTerminal->append("<- " + text);
     }
 
-    if(m_initialized && !dataReceived.isEmpty())
+    if(m_initialized && !data.isEmpty())
     {
 
         try
         {
-            dataReceived = dataReceived.trimmed().simplified();
-            dataReceived.remove(QRegExp("[\\n\\t\\r]"));
-            dataReceived.remove(QRegExp("[^a-zA-Z0-9]+"));
-            analysData(dataReceived);
+            analysData(data);
         }
         catch (const std::exception& e)
         {
@@ -354,40 +483,18 @@ void MainWindow::dataReceived(QString dataReceived)
 
 void MainWindow::getPids()
 {
-    runtimeCommands.clear();
+    // the views ask elm which of their pids the car has
     elm->resetPids();
     ui->textTerminal->append("-> Searching available pids.");
     QString supportedPIDs = elm->get_available_pids();
     ui->textTerminal->append("<- Pids:  " + supportedPIDs);
-
-    if(!supportedPIDs.isEmpty())
-    {
-        if(supportedPIDs.contains(","))
-        {
-            runtimeCommands.append(supportedPIDs.split(","));
-            QString str = runtimeCommands.join("");
-            str = runtimeCommands.join(", ");
-        }
-    }
-}
-
-bool MainWindow::isError(std::string msg) {
-    std::vector<std::string> errors(ERROR, ERROR + 18);
-    for(unsigned int i=0; i < errors.size(); i++) {
-        if(msg.find(errors[i]) != std::string::npos)
-        return true;
-    }
-    return false;
 }
 
 QString MainWindow::send(const QString &command)
 {
     if(m_connectionManager && m_connected)
     {
-        ui->textTerminal->append("-> " + command.trimmed()
-                                 .simplified()
-                                 .remove(QRegExp("[\\n\\t\\r]"))
-                                 .remove(QRegExp("[^a-zA-Z0-9]+")));
+        ui->textTerminal->append("-> " + ElmSanitizer::clean(command));
 
         m_connectionManager->send(command);
         QThread::msleep(5);
@@ -401,31 +508,21 @@ QString MainWindow::getData(const QString &command)
 {
     auto dataReceived = ConnectionManager::getInstance()->readData(command);
 
-    dataReceived.remove("\r");
-    dataReceived.remove(">");
-    dataReceived.remove("?");
-    dataReceived.remove(",");
-
-    if(isError(dataReceived.toUpper().toStdString()))
+    quint32 flags = 0;
+    auto data = QString::fromLatin1(ElmSanitizer::clean(dataReceived, &flags));
+    if(flags & ElmSanitizer::Error)
     {
-        QThread::msleep(500);
         return "error";
     }
 
-    dataReceived = dataReceived.trimmed().simplified();
-    dataReceived.remove(QRegExp("[\\n\\t\\r]"));
-    dataReceived.remove(QRegExp("[^a-zA-Z0-9]+"));
-    return dataReceived;
+    return data;
 }
 
 void MainWindow::saveSettings()
 {
-    QString ip = "192.168.0.10";
-    //QString ip = "0.0.0.0";
-    // python3 -m elm -n 35000 -s car
-    quint16 wifiPort = 35000;
-    m_settingsManager->setWifiIp(ip);
-    m_settingsManager->setWifiPort(wifiPort);
+    // The wifi endpoint is the one that answered last, searched for when
+    // it does not. An emulator (python3 -m elm -n 35000 -s car) is set
+    // with WifiIp and WifiPort in settings.ini.
     m_settingsManager->setSerialPort("/dev/ttys001");
     m_settingsManager->setEngineDisplacement(2700);
     m_settingsManager->saveSettings();
@@ -434,8 +531,21 @@ void MainWindow::saveSettings()
 void MainWindow::on_pushReadFault_clicked()
 {
     ui->textTerminal->append("-> Reading the trouble codes.");
-    QThread::msleep(60);
-    send(READ_TROUBLE);
+
+    // Urgent: a poll still waiting on a slow ecu is interrupted for it.
+    m_reading = true;
+    auto dataReceived = ConnectionManager::getInstance()->readData(READ_TROUBLE, DEFAULT_DEADLINE, true);
+    m_reading = false;
+
+    quint32 flags = 0;
+    auto data = QString::fromLatin1(ElmSanitizer::clean(dataReceived, &flags));
+    if(flags & ElmSanitizer::Error)
+    {
+        ui->textTerminal->append("Error : " + QString::fromLatin1(dataReceived.trimmed()));
+        return;
+    }
+
+    analysData(data);
 }
 
 
@@ -460,7 +570,7 @@ void MainWindow::on_checkSearchPids_toggled(bool checked)
     else
     {
         m_searchPidsEnable = false;
-        runtimeCommands.clear();
+        elm->resetPids();
     }
 }
 
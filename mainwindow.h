@@ -10,6 +10,10 @@
 #include "obdscan.h"
 #include "obdgauge.h"
 #include "elm.h"
+#include "elmsanitizer.h"
+#include "allocationcounter.h"
+#include "elmsessionpool.h"
+#include "elmproxyserver.h"
 
 #define SCREEN_ORIENTATION_LANDSCAPE 0
 #define SCREEN_ORIENTATION_PORTRAIT 1
@@ -81,15 +85,16 @@ private:
     QString getData(const QString &);
     void analysData(const QString &);
     void saveSettings();
-    bool isError(std::string);
     void getPids();
+    void localCommand(const QString &command);
 
     QRect desktopRect{};
     ConnectionManager *m_connectionManager{};
+    ElmSessionPool *m_sessionPool{};
+    ElmProxyServer *m_proxy{};
     SettingsManager *m_settingsManager{};
     ELM *elm{};
 
-    int commandOrder{0};
     bool m_connected{false};
     bool m_initialized{false};
     bool m_reading{false};
@@ -99,7 +104,8 @@ private:
 private slots:
     void connected();
     void disconnected();
-    void dataReceived(QString );
+    void resumed();
+    void dataReceived(QByteArray );
     void stateChanged(QString);
     void on_pushConnect_clicked();
     void on_pushExit_clicked();
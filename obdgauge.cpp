@@ -21,6 +21,7 @@ ObdGauge::ObdGauge(QWidget *parent) :
     labelGps->setText(speedText + "<br>" + altitudeText + "<br>" + timeText);
 
     initGauges();
+    initHistoryChart();
 
     foreach (QScreen *screen, QGuiApplication::screens())
     {
@@ -29,7 +30,8 @@ ObdGauge::ObdGauge(QWidget *parent) :
             ui->gridLayout_Gauges->addWidget(mBoostGauge, 0, 0);
             ui->gridLayout_Gauges->addWidget(mMapGauge, 0, 1);
             ui->gridLayout_Gauges->addWidget(mCoolentGauge, 0, 2);
-            ui->gridLayout_Gauges->addWidget(labelGps, 1, 0, 1, 3);
+            ui->gridLayout_Gauges->addWidget(labelGps, 1, 0);
+            ui->gridLayout_Gauges->addWidget(mHistoryChart, 1, 1, 1, 2);
 
             //mMapGauge->setFixedWidth(100);
 
@@ -45,6 +47,7 @@ ObdGauge::ObdGauge(QWidget *parent) :
             ui->gridLayout_Gauges->addWidget(mBoostGauge, 1, 0);
             ui->gridLayout_Gauges->addWidget(mMapGauge, 2, 0);
             ui->gridLayout_Gauges->addWidget(labelGps, 3, 0);
+            ui->gridLayout_Gauges->addWidget(mHistoryChart, 4, 0);
         }
 
         screen->setOrientationUpdateMask(Qt::LandscapeOrientation |
@@ -55,16 +58,22 @@ ObdGauge::ObdGauge(QWidget *parent) :
         QObject::connect(screen, &QScreen::orientationChanged, this, &ObdGauge::orientationChanged);
     }
 
-    runtimeCommands.clear();
-
-    if(runtimeCommands.isEmpty())
-    {
-        runtimeCommands.append(COOLANT_TEMP);
-        runtimeCommands.append(MAN_ABSOLUTE_PRESSURE);
-    }
+    m_commands.append(COOLANT_TEMP);
+    m_commands.append(MAN_ABSOLUTE_PRESSURE);
+    m_commands.append(ENGINE_RPM);
+    m_commands.append(VEHICLE_SPEED);
 
     m_gps = new Gps(this);
 
+    m_channels = DerivedChannels::getInstance();
+    connect(m_channels, &DerivedChannels::channelUpdated, this, &ObdGauge::channelUpdated);
+
+    m_detector = TripDetector::getInstance();
+    m_dutyCycle = new DutyCycle(m_detector, ConnectionManager::getInstance());
+    TripLogger::getInstance();
+    connect(m_detector, &TripDetector::stateChanged, this, &ObdGauge::tripStateChanged);
+    ConnectionManager::getInstance()->subscribe();
+
     startQueue();
 
     //    if(ConnectionManager::getInstance() && ConnectionManager::getInstance()->isConnected())
@@ -78,21 +87,34 @@ ObdGauge::ObdGauge(QWidget *parent) :
 ObdGauge::~ObdGauge()
 {
     stopQueue();
+    mHistoryChart->stop();
     if(m_gps)
         delete m_gps;
+    delete m_dutyCycle;
     delete ui;
 }
 
 void ObdGauge::startQueue()
 {
     m_realTime = 0;
-    m_timerId  = startTimer(interval);
+    m_timerId  = startTimer(m_dutyCycle->timerInterval());
     m_time.start();
 }
 
 void ObdGauge::stopQueue()
 {
     if ( m_timerId ) killTimer( m_timerId );
+    m_timerId = 0;
+}
+
+void ObdGauge::tripStateChanged(int state)
+{
+    Q_UNUSED(state)
+
+    // engine off: one probe per period, otherwise back to the full poll list
+    stopQueue();
+    commandOrder = 0;
+    startQueue();
 }
 
 void ObdGauge::initGauges()
@@ -363,6 +385,17 @@ void ObdGauge::initGauges()
     ui->verticalLayout->addWidget(container);*/
 }
 
+void ObdGauge::initHistoryChart()
+{
+    // rpm, map and speed over the last minute, straight from the sample store
+    mHistoryChart = new StripChart;
+    mHistoryChart->setTimeSpan(60000);
+    mHistoryChart->addTrace(CH_ENGINE_RPM, QColor("#00cccc"), 0, 8000);
+    mHistoryChart->addTrace(CH_MAN_ABSOLUTE_PRESSURE, Qt::yellow, 0, 255);
+    mHistoryChart->addTrace(CH_VEHICLE_SPEED, Qt::white, 0, 220);
+    mHistoryChart->start();
+}
+
 void ObdGauge::setSpeed(int speed)
 {
     mSpeedNeedle->setCurrentValue(speed);
@@ -395,21 +428,23 @@ void ObdGauge::timerEvent( QTimerEvent *event )
     if(!ConnectionManager::getInstance()->isConnected())
         return;
 
-    if(runtimeCommands.size() == 0)
-        return;
-
-    if(runtimeCommands.size() == commandOrder)
+    if(m_dutyCycle->isIdle())
     {
-        commandOrder = 0;
+        m_dutyCycle->probe([this](const QString &command) { return request(command); });
     }
-
-    if(commandOrder < runtimeCommands.size())
+    else if(m_commands.size() > 0)
     {
-        auto dataReceived = getData(runtimeCommands[commandOrder]);
-        if(dataReceived != "error")
-            analysData(dataReceived);
-        //ui->labelCommand->setText(runtimeCommands[commandOrder]);
-        commandOrder++;
+        if(m_commands.size() == commandOrder)
+        {
+            commandOrder = 0;
+        }
+
+        if(commandOrder < m_commands.size())
+        {
+            request(m_commands[commandOrder]);
+            //ui->labelCommand->setText(m_commands[commandOrder]);
+            commandOrder++;
+        }
     }
 
     if(m_gps)
@@ -422,6 +457,7 @@ void ObdGauge::timerEvent( QTimerEvent *event )
             groundspeed = 3.6 * m_gpsPos.attribute(QGeoPositionInfo::GroundSpeed);
             if(Gps::IsNan((float)groundspeed)) groundspeed = 0;
 
+            int lastAltitude = altitude;
             altitude = m_coord.altitude();
             if(Gps::IsNan((float)altitude))  altitude = 0;
 
@@ -434,7 +470,8 @@ void ObdGauge::timerEvent( QTimerEvent *event )
             QString timeText =  "<font color='yellow'>" + dateTimeString + "</font>"; // Use HTML formatting for color
             labelGps->setText(speedText + "<br>" + altitudeText + "<br>" + timeText);
 
-            barometric_pressure = Gps::barometricPressure(altitude) * 0.000145037738; // pascals to psi
+            if(altitude != lastAltitude || !m_channels->hasValue(CH_GPS_BAROMETRIC_PRESSURE))
+                m_channels->update(CH_GPS_BAROMETRIC_PRESSURE, Gps::barometricPressure(altitude) / 1000.0); // pascals to kPa
         }
     }
 }
@@ -450,131 +487,119 @@ QString ObdGauge::send(const QString &command)
     return QString();
 }
 
-bool ObdGauge::isError(std::string msg) {
-    std::vector<std::string> errors(ERROR, ERROR + 18);
-    for(unsigned int i=0; i < errors.size(); i++) {
-        if(msg.find(errors[i]) != std::string::npos)
-            return true;
-    }
-    return false;
-}
-
-QString ObdGauge::getData(const QString &command)
+QByteArray ObdGauge::request(const QString &command)
 {
     auto dataReceived = ConnectionManager::getInstance()->readData(command);
 
-    dataReceived.remove("\r");
-    dataReceived.remove(">");
-    dataReceived.remove("?");
-    dataReceived.remove(",");
+    char data[ElmSanitizer::REPLY_CAPACITY];
+    int length = 0;
+    quint32 flags = ElmSanitizer::sanitize(dataReceived, data, ElmSanitizer::REPLY_CAPACITY, length);
 
-    if(isError(dataReceived.toUpper().toStdString()))
+    if(flags & ElmSanitizer::Error)
     {
-        return "error";
+        // a sleeping ecu, counts towards ignition off
+        if(command.startsWith("01") && (dataReceived.contains("NO DATA") || dataReceived.contains("UNABLE TO CONNECT")))
+            m_detector->noData(currentTimeMillis());
+        return dataReceived;
     }
 
-    dataReceived = dataReceived.trimmed().simplified();
-    dataReceived.remove(QRegExp("[\\n\\t\\r]"));
-    dataReceived.remove(QRegExp("[^a-zA-Z0-9]+"));
+    analysData(data, length);
     return dataReceived;
 }
 
-void ObdGauge::analysData(const QString &dataReceived)
+void ObdGauge::analysData(const char *data, int length)
 {
     unsigned A = 0;
     unsigned B = 0;
     unsigned PID = 0;
     double value = 0;
 
-    std::vector<QString> vec;
-    auto resp= elm->prepareResponseToDecode(dataReceived);
-
-    if(resp.size()>2 && !resp[0].compare("41",Qt::CaseInsensitive))
+    if(ELM::decodePid(data, length, PID, A, B))
     {
-        QRegularExpression hexMatcher("^[0-9A-F]{2}$", QRegularExpression::CaseInsensitiveOption);
-        QRegularExpressionMatch match = hexMatcher.match(resp[1]);
-        if (!match.hasMatch())
-            return;
-
-        PID =std::stoi(resp[1].toStdString(),nullptr,16);
-        std::vector<QString> vec;
-
-        vec.insert(vec.begin(),resp.begin()+2, resp.end());
-        if(vec.size()>=2)
-        {
-            A = std::stoi(vec[0].toStdString(),nullptr,16);
-            B = std::stoi(vec[1].toStdString(),nullptr,16);
-        }
-        else if(vec.size()>=1)
-        {
-            A = std::stoi(vec[0].toStdString(),nullptr,16);
-            B = 0;
-        }       
-
         switch (PID)
         {        
         case 5://PID(05): Coolant Temperature
             // A-40
             value = A - 40;
-            setCoolent(value);
             break;        
         case 12: //PID(0C): RPM
             //((A*256)+B)/4
             value = ((A * 256) + B) / 4;
-            setRpm(static_cast<int>(value / 100));
             break;
         case 13://PID(0D): KM Speed
             // A
             value = A;
-            setSpeed(static_cast<int>(value));
             break;
         case 51://PID(33) Absolute Barometric Pressure
             //A kPa
             value = A;
-            barometric_pressure = value * 0.1450377377; //kPa to psi
             break;
         case 11://PID(0B): Manifold Absolute Pressure
             // A kPa
             value = A;
-            if (barometric_pressure == 0.0)
-            {
-                barometric_pressure = 14.7; // psi
-            }
-
-            setMap(value);
-            setBoost(value * 0.1450377377 - barometric_pressure);
             break;
         default:
-            //A
-            value = A;
-            break;
+            return;
         }
+
+        // Gauges follow the channel graph, derived values such as boost included.
+        m_channels->update(PID, value);
+    }
+
+    // ATRV, only polled by the keep-alive while parked
+    if(ELM::decodeVoltage(data, length, value))
+        m_channels->update(CH_VOLTAGE, value);
+}
+
+void ObdGauge::channelUpdated(int channel, double value, qint64 timestamp)
+{
+    Q_UNUSED(timestamp)
+
+    switch (channel)
+    {
+    case CH_COOLANT_TEMP:
+        setCoolent(value);
+        break;
+    case CH_ENGINE_RPM:
+        setRpm(static_cast<int>(value / 100));
+        break;
+    case CH_VEHICLE_SPEED:
+        setSpeed(static_cast<int>(value));
+        break;
+    case CH_MAN_ABSOLUTE_PRESSURE:
+        setMap(value);
+        break;
+    case CH_BOOST:
+        setBoost(value);
+        break;
+    default:
+        break;
     }
 }
 
-void ObdGauge::dataReceived(QString dataReceived)
+void ObdGauge::dataReceived(QByteArray dataReceived)
 {
     if(!mRunning)return;
 
-    if(runtimeCommands.size() == commandOrder)
+    if(m_commands.size() == commandOrder)
     {
         commandOrder = 0;
-        send(runtimeCommands[commandOrder]);
-        //        labelCommand->setText(runtimeCommands.join(", ") + "\n" + runtimeCommands[commandOrder]);
+        send(m_commands[commandOrder]);
+        //        labelCommand->setText(m_commands.join(", ") + "\n" + m_commands[commandOrder]);
     }
 
-    if(commandOrder < runtimeCommands.size())
+    if(commandOrder < m_commands.size())
     {
-        send(runtimeCommands[commandOrder]);
+        send(m_commands[commandOrder]);
         commandOrder++;
     }
 
     try
     {
-        dataReceived = dataReceived.trimmed().simplified();
-        dataReceived.remove(QRegExp("[\\n\\t\\r]"));
-        dataReceived.remove(QRegExp("[^a-zA-Z0-9]+"));
-        analysData(dataReceived);
+        char data[ElmSanitizer::REPLY_CAPACITY];
+        int length = 0;
+        ElmSanitizer::sanitize(dataReceived, data, ElmSanitizer::REPLY_CAPACITY, length);
+        analysData(data, length);
     }
     catch (const std::exception& e)
     {
@@ -589,6 +614,9 @@ void ObdGauge::closeEvent(QCloseEvent *event)
     Q_UNUSED(event);
     mRunning = false;
     stopQueue();
+    m_dutyCycle->wake([this](const QString &command) { return request(command); });
+    ConnectionManager::getInstance()->unsubscribe();
+    mHistoryChart->stop();
 }
 
 
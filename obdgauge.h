@@ -7,9 +7,15 @@
 #include <QLabel>
 #include "global.h"
 #include "gps.h"
+#include "derivedchannels.h"
+#include "tripdetector.h"
+#include "dutycycle.h"
+#include "triplogger.h"
 
 #include "qcgaugewidget.h"
+#include "stripchart.h"
 #include "elm.h"
+#include "elmsanitizer.h"
 
 namespace Ui {
 class ObdGauge;
@@ -25,6 +31,7 @@ public:
 
 private:
     int commandOrder{0};
+    QStringList m_commands{};
 
     int m_timerId{};
     float m_realTime{};
@@ -34,13 +41,15 @@ private:
 
     int valueGauge{0};
     int map{0};
-    double barometric_pressure{0.0};
     int altitude{0};
     int groundspeed{0};
 
     bool mRunning{false};
 
     Gps *m_gps{};
+    DerivedChannels *m_channels{};
+    TripDetector *m_detector{};
+    DutyCycle *m_dutyCycle{};
 
     QcGaugeWidget * mSpeedGauge{};
     QcNeedleItem *mSpeedNeedle{};
@@ -57,17 +66,19 @@ private:
     QcGaugeWidget * mMapGauge{};
     QcNeedleItem *mMapNeedle{};
 
+    StripChart *mHistoryChart{};
+
     ELM *elm{};
 
     void startQueue();
     void stopQueue();
 
     QString send(const QString &);
-    QString getData(const QString &);
-    bool isError(std::string);
+    QByteArray request(const QString &);
 
-    void analysData(const QString &);
+    void analysData(const char *, int);
     void initGauges();
+    void initHistoryChart();
     void setSpeed(int);
     void setRpm(int);
     void setCoolent(float);
@@ -75,7 +86,9 @@ private:
     void setMap(int);
 
 private slots:
-    void dataReceived(QString);
+    void dataReceived(QByteArray);
+    void channelUpdated(int, double, qint64);
+    void tripStateChanged(int);
     void orientationChanged(Qt::ScreenOrientation );
 
 protected:
@@ -26,22 +26,36 @@ ObdScan::ObdScan(QWidget *parent) :
     ui->labelVoltage->setText(QString::number(0, 'f', 1) + " V");
     ui->labelCommand->setStyleSheet("font-size: 24pt; font-weight: bold; color: #ECF0F1; background-color: #154360 ; padding: 6px; spacing: 6px;");
 
+    ui->labelFuelTitle->setStyleSheet("font-size: 32pt; font-weight: bold; color: #ECF0F1; padding: 6px; spacing: 6px;");
+    ui->labelFuel->setStyleSheet("font-size: 32pt; font-weight: bold; color: #ECF0F1; background-color: #154360 ; padding: 6px; spacing: 6px;");
+
+    ui->labelAverageTitle->setStyleSheet("font-size: 32pt; font-weight: bold; color: #ECF0F1; padding: 6px; spacing: 6px;");
+    ui->labelAverage->setStyleSheet("font-size: 32pt; font-weight: bold; color: #ECF0F1; background-color: #154360 ; padding: 6px; spacing: 6px;");
+
     ui->pushExit->setStyleSheet("font-size: 22pt; font-weight: bold; color: #ECF0F1; background-color: #512E5F; padding: 6px; spacing: 6px;");
 
-    runtimeCommands.clear();
+    elm = ELM::getInstance();
+    m_channels = DerivedChannels::getInstance();
+    connect(m_channels, &DerivedChannels::channelUpdated, this, &ObdScan::channelUpdated);
 
-    if(runtimeCommands.isEmpty())
-    {
-        runtimeCommands.append(VOLTAGE);
-        runtimeCommands.append(MAN_ABSOLUTE_PRESSURE);
-        runtimeCommands.append(VEHICLE_SPEED);
-        runtimeCommands.append(ENGINE_RPM);
-        runtimeCommands.append(ENGINE_LOAD);
-        runtimeCommands.append(COOLANT_TEMP);
-        //0104, 0105, 010B, 010C, 010D, 010F, 0110, 0111, 011C
-    }
+    m_commands.append(VOLTAGE);
+    m_commands.append(MAN_ABSOLUTE_PRESSURE);
+    m_commands.append(VEHICLE_SPEED);
+    m_commands.append(ENGINE_RPM);
+    m_commands.append(ENGINE_LOAD);
+    m_commands.append(COOLANT_TEMP);
+    //0104, 0105, 010B, 010C, 010D, 010F, 0110, 0111, 011C
 
-     startQueue();
+    setupFuelModel();
+    initOperatingMap();
+
+    m_detector = TripDetector::getInstance();
+    m_dutyCycle = new DutyCycle(m_detector, ConnectionManager::getInstance());
+    TripLogger::getInstance();
+    connect(m_detector, &TripDetector::stateChanged, this, &ObdScan::tripStateChanged);
+    ConnectionManager::getInstance()->subscribe();
+
+    startQueue();
 
     //    if(ConnectionManager::getInstance() && ConnectionManager::getInstance()->isConnected())
     //    {
@@ -53,19 +67,73 @@ ObdScan::ObdScan(QWidget *parent) :
 
 ObdScan::~ObdScan()
 {
+    delete m_dutyCycle;
     delete ui;
 }
 
+void ObdScan::setupFuelModel()
+{
+    FuelConsumption &fuel = m_channels->fuel();
+    fuel.setDisplacement(SettingsManager::getInstance()->getEngineDisplacement());
+    fuel.selectModel([this](quint8 pid) { return elm->isPidAvailable(pid); }, elm->pidsChecked());
+    m_channels->resetTrip();
+
+    // Poll only what the chosen model reads, on top of the displayed values.
+    for(auto &command : fuel.requiredCommands())
+    {
+        if(!m_commands.contains(command))
+            m_commands.append(command);
+    }
+
+    ui->labelFuelTitle->setText("Fuel (" + fuel.modelName() + "):");
+}
+
+void ObdScan::initOperatingMap()
+{
+    TripStatistics *trip = TripStatistics::getInstance();
+
+    // Without a calculated load value the map pressure is the next best axis.
+    QString title = "Rpm x Load";
+    if(elm->pidsChecked() && !elm->isPidAvailable(0x04))
+    {
+        trip->setOperatingAxis(CH_MAN_ABSOLUTE_PRESSURE, 0, 255);
+        title = "Rpm x Map";
+    }
+    else
+    {
+        trip->setOperatingAxis(CH_ENGINE_LOAD, 0, 100);
+    }
+
+    m_heatmap = new HeatmapWidget;
+    m_heatmap->setTitle(title);
+    m_heatmap->setMap(&trip->operatingMap());
+    connect(trip, &TripStatistics::operatingCellChanged, m_heatmap, &HeatmapWidget::updateCell);
+    connect(trip, &TripStatistics::operatingMapChanged, m_heatmap, &HeatmapWidget::rebuild);
+
+    ui->gridLayout_2->addWidget(m_heatmap, 3, 0);
+}
+
 void ObdScan::startQueue()
 {
     m_realTime = 0;
-    m_timerId  = startTimer(interval);
+    m_timerId  = startTimer(m_dutyCycle->timerInterval());
     m_time.start();
 }
 
 void ObdScan::stopQueue()
 {
     if ( m_timerId ) killTimer( m_timerId );
+    m_timerId = 0;
+}
+
+void ObdScan::tripStateChanged(int state)
+{
+    Q_UNUSED(state)
+
+    // engine off: one probe per period, otherwise back to the full poll list
+    stopQueue();
+    commandOrder = 0;
+    startQueue();
 }
 
 void ObdScan::closeEvent (QCloseEvent *event)
@@ -73,6 +141,8 @@ void ObdScan::closeEvent (QCloseEvent *event)
     Q_UNUSED(event);
     mRunning = false;
     stopQueue();
+    m_dutyCycle->wake([this](const QString &command) { return request(command); });
+    ConnectionManager::getInstance()->unsubscribe();
 }
 
 void ObdScan::on_pushExit_clicked()
@@ -92,32 +162,23 @@ QString ObdScan::send(const QString &command)
 }
 
 
-bool ObdScan::isError(std::string msg) {
-    std::vector<std::string> errors(ERROR, ERROR + 18);
-    for(unsigned int i=0; i < errors.size(); i++) {
-        if(msg.find(errors[i]) != std::string::npos)
-            return true;
-    }
-    return false;
-}
-
-QString ObdScan::getData(const QString &command)
+QByteArray ObdScan::request(const QString &command)
 {
-    auto dataReceived =ConnectionManager::getInstance()->readData(command);
+    auto dataReceived = ConnectionManager::getInstance()->readData(command);
 
-    dataReceived.remove("\r");
-    dataReceived.remove(">");
-    dataReceived.remove("?");
-    dataReceived.remove(",");
+    char data[ElmSanitizer::REPLY_CAPACITY];
+    int length = 0;
+    quint32 flags = ElmSanitizer::sanitize(dataReceived, data, ElmSanitizer::REPLY_CAPACITY, length);
 
-    if(isError(dataReceived.toUpper().toStdString()))
+    if(flags & ElmSanitizer::Error)
     {
-        return "error";
+        // a sleeping ecu, counts towards ignition off
+        if(command.startsWith("01") && (dataReceived.contains("NO DATA") || dataReceived.contains("UNABLE TO CONNECT")))
+            m_detector->noData(currentTimeMillis());
+        return dataReceived;
     }
 
-    dataReceived = dataReceived.trimmed().simplified();
-    dataReceived.remove(QRegExp("[\\n\\t\\r]"));
-    dataReceived.remove(QRegExp("[^a-zA-Z0-9]+"));
+    analysData(data, length);
     return dataReceived;
 }
 
@@ -128,49 +189,54 @@ void ObdScan::timerEvent( QTimerEvent *event )
     if(!ConnectionManager::getInstance()->isConnected())
         return;
 
-    if(runtimeCommands.size() == 0)
+    if(m_dutyCycle->isIdle())
+    {
+        ui->labelCommand->setText("Engine off");
+        m_dutyCycle->probe([this](const QString &command) { return request(command); });
+        return;
+    }
+
+    if(m_commands.size() == 0)
         return;
 
-    if(runtimeCommands.size() == commandOrder)
+    if(m_commands.size() == commandOrder)
     {
         commandOrder = 0;
     }
 
-    if(commandOrder < runtimeCommands.size())
+    if(commandOrder < m_commands.size())
     {
-        auto dataReceived = getData(runtimeCommands[commandOrder]);
-        if(dataReceived != "error")
-            analysData(dataReceived);
-        ui->labelCommand->setText(runtimeCommands[commandOrder]);
+        request(m_commands[commandOrder]);
+        ui->labelCommand->setText(m_commands[commandOrder]);
         commandOrder++;
     }
 }
 
 
-void ObdScan::dataReceived(QString dataReceived)
+void ObdScan::dataReceived(QByteArray dataReceived)
 {
     if(!mRunning)return;
 
-    if(runtimeCommands.size() == commandOrder)
+    if(m_commands.size() == commandOrder)
     {
         commandOrder = 0;
-        send(runtimeCommands[commandOrder]);
-        //ui->labelCommand->setText(runtimeCommands.join(", ") + "\n" + runtimeCommands[commandOrder]);
+        send(m_commands[commandOrder]);
+        //ui->labelCommand->setText(m_commands.join(", ") + "\n" + m_commands[commandOrder]);
     }
 
-    if(commandOrder < runtimeCommands.size())
+    if(commandOrder < m_commands.size())
     {
-        send(runtimeCommands[commandOrder]);
-        //ui->labelCommand->setText(runtimeCommands.join(", ") + "\n" + runtimeCommands[commandOrder]);
+        send(m_commands[commandOrder]);
+        //ui->labelCommand->setText(m_commands.join(", ") + "\n" + m_commands[commandOrder]);
         commandOrder++;
     }
 
     try
     {
-        dataReceived = dataReceived.trimmed().simplified();
-        dataReceived.remove(QRegExp("[\\n\\t\\r]"));
-        dataReceived.remove(QRegExp("[^a-zA-Z0-9]+"));
-        analysData(dataReceived);
+        char data[ElmSanitizer::REPLY_CAPACITY];
+        int length = 0;
+        ElmSanitizer::sanitize(dataReceived, data, ElmSanitizer::REPLY_CAPACITY, length);
+        analysData(data, length);
     }
     catch (const std::exception& e)
     {       
@@ -181,38 +247,16 @@ void ObdScan::dataReceived(QString dataReceived)
 
 }
 
-void ObdScan::analysData(const QString &dataReceived)
+void ObdScan::analysData(const char *data, int length)
 {
     unsigned A = 0;
     unsigned B = 0;
     unsigned PID = 0;
     double value = 0;
+    bool decoded = true;
 
-    std::vector<QString> vec;
-    auto resp= elm->prepareResponseToDecode(dataReceived);
-
-    if(resp.size()>2 && !resp[0].compare("41",Qt::CaseInsensitive))
+    if(ELM::decodePid(data, length, PID, A, B))
     {
-        QRegularExpression hexMatcher("^[0-9A-F]{2}$", QRegularExpression::CaseInsensitiveOption);
-        QRegularExpressionMatch match = hexMatcher.match(resp[1]);
-        if (!match.hasMatch())
-            return;
-
-        PID =std::stoi(resp[1].toStdString(),nullptr,16);
-        std::vector<QString> vec;
-
-        vec.insert(vec.begin(),resp.begin()+2, resp.end());
-        if(vec.size()>=2)
-        {
-            A = std::stoi(vec[0].toStdString(),nullptr,16);
-            B = std::stoi(vec[1].toStdString(),nullptr,16);
-        }
-        else if(vec.size()>=1)
-        {
-            A = std::stoi(vec[0].toStdString(),nullptr,16);
-            B = 0;
-        }
-
         switch (PID)
         {
 
@@ -249,7 +293,8 @@ void ObdScan::analysData(const QString &dataReceived)
             value = A - 40;
             break;
         case 16://PID(10): MAF air flow rate grams/sec
-            // ((256*A)+B) / 100  [g/s]           
+            // ((256*A)+B) / 100  [g/s]
+            value = ((256 * A) + B) / 100.0;
             break;
         case 17://PID(11): Throttle position
             // (100 * A) / 255 %
@@ -289,12 +334,7 @@ void ObdScan::analysData(const QString &dataReceived)
             break;
         case 94://PID(5E) Fuel rate
             // ((A*256)+B) / 20
-            {
-                value = ((A*256)+B) / 20;
-                /*mAvarageFuelConsumption.append(value);
-            ui->labelFuelConsumption->setText(QString::number(calculateAverage(mAvarageFuelConsumption), 'f', 1) + " l / h");*/
-            }
-
+            value = ((A*256)+B) / 20.0;
             break;
         case 98://PID(62) Actual engine - percent torque
             // A-125
@@ -303,17 +343,40 @@ void ObdScan::analysData(const QString &dataReceived)
         default:
             //A
             value = A;
+            decoded = false;
             break;
-        }       
+        }
+
+        if(decoded)
+            m_channels->update(PID, value);
     }
 
-    if (dataReceived.contains(QRegExp("\\s*[0-9]{1,2}([.][0-9]{1,2})?V\\s*")))
+    if(ELM::decodeVoltage(data, length, value))
     {
-        auto voltData = dataReceived;
-        voltData.remove("ATRV").remove("atrv");
-        if(voltData.length() > 3)
-        {
-            ui->labelVoltage->setText(voltData.mid(0,2) + "." + voltData.mid(2,1) + " V");
-        }
+        ui->labelVoltage->setText(QString::number(value, 'f', 1) + " V");
+        m_channels->update(CH_VOLTAGE, value);
+    }
+}
+
+void ObdScan::channelUpdated(int channel, double value, qint64 timestamp)
+{
+    Q_UNUSED(timestamp)
+
+    switch (channel)
+    {
+    case CH_FUEL_FLOW:
+        ui->labelFuel->setText(QString::number(value, 'f', 1) + " l/h");
+        break;
+    case CH_AVERAGE_CONSUMPTION:
+    {
+        double window = 0.0;
+        QString text = QString::number(value, 'f', 1);
+        if(m_channels->fuel().windowAverage(window))
+            text.append(" / " + QString::number(window, 'f', 1));
+        ui->labelAverage->setText(text + " l/100km");
+        break;
+    }
+    default:
+        break;
     }
 }
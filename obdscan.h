@@ -4,6 +4,13 @@
 #include "global.h"
 #include "elm.h"
 #include "settingsmanager.h"
+#include "derivedchannels.h"
+#include "tripdetector.h"
+#include "dutycycle.h"
+#include "triplogger.h"
+#include "tripstatistics.h"
+#include "heatmapwidget.h"
+#include "elmsanitizer.h"
 
 namespace Ui {
 class ObdScan;
@@ -26,19 +33,27 @@ private:
 
     bool mRunning{false};
     int commandOrder{0};
+    QStringList m_commands{};
 
     ELM *elm{};
+    DerivedChannels *m_channels{};
+    TripDetector *m_detector{};
+    DutyCycle *m_dutyCycle{};
+    HeatmapWidget *m_heatmap{};
 
+    void setupFuelModel();
+    void initOperatingMap();
     QString send(const QString &);
-    QString getData(const QString &);
-    bool isError(std::string);
+    QByteArray request(const QString &);
 
-    void analysData(const QString &);
+    void analysData(const char *, int);
     void startQueue();
     void stopQueue();
 
 public slots:
-    void dataReceived(QString);
+    void dataReceived(QByteArray);
+    void channelUpdated(int, double, qint64);
+    void tripStateChanged(int);
 
 private slots:
     void on_pushExit_clicked();
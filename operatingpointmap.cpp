@@ -0,0 +1,130 @@
+#include "operatingpointmap.h"
+#include <algorithm>
+
+OperatingPointMap::OperatingPointMap(int columns, double xMin, double xMax, int rows, double yMin, double yMax) :
+    m_columns(std::max(1, columns)),
+    m_rows(std::max(1, rows)),
+    m_xMin(xMin),
+    m_xMax(xMax),
+    m_yMin(yMin),
+    m_yMax(yMax)
+{
+    m_cells.assign(static_cast<size_t>(m_columns * m_rows), 0.0);
+}
+
+int OperatingPointMap::add(double x, double y, double seconds)
+{
+    int index = row(y) * m_columns + column(x);
+
+    double &cell = m_cells[static_cast<size_t>(index)];
+    cell += seconds;
+    m_total += seconds;
+    m_maximum = std::max(m_maximum, cell);
+
+    return index;
+}
+
+bool OperatingPointMap::merge(const OperatingPointMap &other)
+{
+    if(other.m_columns != m_columns || other.m_rows != m_rows ||
+            other.m_xMin != m_xMin || other.m_xMax != m_xMax ||
+            other.m_yMin != m_yMin || other.m_yMax != m_yMax)
+        return false;
+
+    for(size_t i = 0; i < m_cells.size(); i++)
+    {
+        m_cells[i] += other.m_cells[i];
+        m_maximum = std::max(m_maximum, m_cells[i]);
+    }
+    m_total += other.m_total;
+    return true;
+}
+
+void OperatingPointMap::clear()
+{
+    std::fill(m_cells.begin(), m_cells.end(), 0.0);
+    m_maximum = 0.0;
+    m_total = 0.0;
+}
+
+int OperatingPointMap::columns() const
+{
+    return m_columns;
+}
+
+int OperatingPointMap::rows() const
+{
+    return m_rows;
+}
+
+int OperatingPointMap::column(double x) const
+{
+    int index = static_cast<int>((x - m_xMin) / (m_xMax - m_xMin) * m_columns);
+    return std::min(m_columns - 1, std::max(0, index));
+}
+
+int OperatingPointMap::row(double y) const
+{
+    int index = static_cast<int>((y - m_yMin) / (m_yMax - m_yMin) * m_rows);
+    return std::min(m_rows - 1, std::max(0, index));
+}
+
+double OperatingPointMap::cell(int column, int row) const
+{
+    if(column < 0 || column >= m_columns || row < 0 || row >= m_rows)
+        return 0.0;
+
+    return m_cells[static_cast<size_t>(row * m_columns + column)];
+}
+
+double OperatingPointMap::maximum() const
+{
+    return m_maximum;
+}
+
+double OperatingPointMap::total() const
+{
+    return m_total;
+}
+
+QString OperatingPointMap::serialize() const
+{
+    QString text = QString::number(m_columns) + " " + QString::number(m_rows) + " " +
+            QString::number(m_xMin) + " " + QString::number(m_xMax) + " " +
+            QString::number(m_yMin) + " " + QString::number(m_yMax);
+
+    for(size_t i = 0; i < m_cells.size(); i++)
+    {
+        if(m_cells[i] > 0.0)
+            text.append(";" + QString::number(static_cast<int>(i)) + ":" + QString::number(m_cells[i], 'g', 10));
+    }
+    return text;
+}
+
+OperatingPointMap OperatingPointMap::deserialize(const QString &text)
+{
+    auto parts = text.split(";");
+    auto header = parts[0].split(" ");
+    if(header.size() != 6)
+        return OperatingPointMap();
+
+    OperatingPointMap map(header[0].toInt(), header[2].toDouble(), header[3].toDouble(),
+            header[1].toInt(), header[4].toDouble(), header[5].toDouble());
+
+    for(int i = 1; i < parts.size(); i++)
+    {
+        auto pair = parts[i].split(":");
+        if(pair.size() != 2)
+            continue;
+
+        int index = pair[0].toInt();
+        double seconds = pair[1].toDouble();
+        if(index < 0 || index >= static_cast<int>(map.m_cells.size()) || seconds <= 0.0)
+            continue;
+
+        map.m_cells[static_cast<size_t>(index)] += seconds;
+        map.m_total += seconds;
+        map.m_maximum = std::max(map.m_maximum, map.m_cells[static_cast<size_t>(index)]);
+    }
+    return map;
+}
@@ -0,0 +1,49 @@
+#ifndef OPERATINGPOINTMAP_H
+#define OPERATINGPOINTMAP_H
+
+#include <QtCore>
+#include <vector>
+
+// Time-weighted 2D histogram of the engine operating point, rpm on x and
+// load or map on y. Bins are fixed, so adding a sample is a single cell
+// update and maps of different trips merge by adding their cells.
+class OperatingPointMap
+{
+public:
+    OperatingPointMap(int columns = 32, double xMin = 0, double xMax = 8000,
+                      int rows = 20, double yMin = 0, double yMax = 100);
+
+    // Adds seconds spent at (x, y), out of range values go to the edge cells.
+    // Returns the cell index that changed.
+    int add(double x, double y, double seconds);
+    // Only maps with the same bins can be merged.
+    bool merge(const OperatingPointMap &other);
+    void clear();
+
+    int columns() const;
+    int rows() const;
+    int column(double x) const;
+    int row(double y) const;
+
+    double cell(int column, int row) const;
+    double maximum() const;
+    double total() const;
+
+    // "columns rows xMin xMax yMin yMax;index:seconds;..." non-empty cells only
+    QString serialize() const;
+    static OperatingPointMap deserialize(const QString &text);
+
+private:
+    int m_columns;
+    int m_rows;
+    double m_xMin;
+    double m_xMax;
+    double m_yMin;
+    double m_yMax;
+
+    std::vector<double> m_cells{};
+    double m_maximum{0.0};
+    double m_total{0.0};
+};
+
+#endif // OPERATINGPOINTMAP_H
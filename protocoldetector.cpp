@@ -0,0 +1,171 @@
+#include "protocoldetector.h"
+#include "elminitializer.h"
+
+ProtocolDetector::ProtocolDetector()
+{
+}
+
+QString ProtocolDetector::detect(const Request &request, const Drain &drain, const QString &cached)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    m_protocol.clear();
+    m_fromCache = false;
+    m_searching = false;
+    m_fromSearch = false;
+    m_probes = 0;
+
+    if(!cached.isEmpty())
+    {
+        if(probe(request, drain, cached))
+        {
+            m_protocol = cached;
+            m_fromCache = true;
+        }
+        else
+        {
+            // Ecu asleep rather than another bus: the first request searches,
+            // starting with the cached protocol.
+            request(SET_PROTOCOL + "A" + cached, ElmInitializer::SETTING_DEADLINE);
+            m_searching = true;
+            m_elapsed = timer.elapsed();
+            return QString();
+        }
+    }
+    else
+    {
+        for(auto &protocol : fleetOrder())
+        {
+            if(probe(request, drain, protocol))
+            {
+                m_protocol = protocol;
+                break;
+            }
+        }
+    }
+
+    if(m_protocol.isEmpty())
+    {
+        request(PROTOCOL_AUTO, ElmInitializer::SETTING_DEADLINE);
+        m_searching = true;
+    }
+    else
+    {
+        // ATTP only tried it; ATSP keeps it over a reset as well
+        request(SET_PROTOCOL + m_protocol, ElmInitializer::SETTING_DEADLINE);
+
+        auto answer = protocolNumber(request(GET_PROTOCOL_NUMBER, ElmInitializer::SETTING_DEADLINE));
+        if(!answer.isEmpty())
+            m_protocol = answer;
+    }
+
+    m_elapsed = timer.elapsed();
+    return m_protocol;
+}
+
+bool ProtocolDetector::probe(const Request &request, const Drain &drain, const QString &protocol)
+{
+    m_probes++;
+
+    request(TRY_PROTOCOL + protocol, ElmInitializer::SETTING_DEADLINE);
+    auto answer = request(PIDS_SUPPORTED20, deadline(protocol)).toUpper();
+    answer.remove(" ");
+
+    // ISO and KWP report the bus init on a line of its own before the data
+    bool busInit = answer.contains("BUSINIT") && answer.contains("OK");
+    bool answered = answer.contains("4100");
+
+    if(busInit || !answer.contains(">"))
+        drain();
+
+    // A bus that comes up is not yet an ecu that answers: its data line
+    // may have been cut off, asked once more on the open bus.
+    if(busInit && !answered)
+    {
+        answer = request(PIDS_SUPPORTED20, deadline(protocol)).toUpper();
+        answer.remove(" ");
+        answered = answer.contains("4100");
+        if(!answer.contains(">"))
+            drain();
+    }
+
+    return answered && !answer.contains("ERROR");
+}
+
+bool ProtocolDetector::isSearching() const
+{
+    return m_searching;
+}
+
+void ProtocolDetector::searched(const QString &protocol)
+{
+    m_searching = false;
+    m_protocol = protocol;
+    m_fromSearch = true;
+}
+
+QString ProtocolDetector::protocol() const
+{
+    return m_protocol;
+}
+
+bool ProtocolDetector::fromCache() const
+{
+    return m_fromCache;
+}
+
+int ProtocolDetector::probes() const
+{
+    return m_probes;
+}
+
+qint64 ProtocolDetector::elapsed() const
+{
+    return m_elapsed;
+}
+
+QString ProtocolDetector::summary() const
+{
+    if(m_protocol.isEmpty())
+        return QString("Protocol: no ecu answered in %1 ms, auto search").arg(m_elapsed);
+
+    if(m_fromSearch)
+        return QString("Protocol: %1 by auto search, %2 probes in %3 ms before")
+                .arg(m_protocol).arg(m_probes).arg(m_elapsed);
+
+    return QString("Protocol: %1 %2 in %3 ms")
+            .arg(m_protocol)
+            .arg(m_fromCache ? QString("cached") : QString("after %1 probes").arg(m_probes))
+            .arg(m_elapsed);
+}
+
+QStringList ProtocolDetector::fleetOrder()
+{
+    // 6 CAN 11/500, 7 CAN 29/500, 8 CAN 11/250, 9 CAN 29/250,
+    // 3 ISO 9141-2, 5 KWP fast init, 4 KWP 5 baud, 2 J1850 VPW, 1 J1850 PWM
+    return QStringList{"6", "7", "8", "9", "3", "5", "4", "2", "1"};
+}
+
+int ProtocolDetector::deadline(const QString &protocol)
+{
+    if(protocol == "3" || protocol == "4")
+        return 4000;
+    if(protocol == "5")
+        return 1500;
+    if(protocol == "1" || protocol == "2")
+        return 1000;
+
+    return 500;
+}
+
+QString ProtocolDetector::protocolNumber(const QString &answer)
+{
+    QString number = answer;
+    number.remove("\r").remove(">");
+    number = number.trimmed();
+    if(number.size() == 2 && number.startsWith("A"))
+        number.remove(0, 1);
+
+    return number.size() == 1 ? number : QString();
+}
@@ -0,0 +1,56 @@
+#ifndef PROTOCOLDETECTOR_H
+#define PROTOCOLDETECTOR_H
+
+#include <functional>
+#include "global.h"
+
+// Finds the obd protocol of the vehicle without the ELM auto search, which
+// walks every protocol with long timeouts. The protocol found last time is
+// tried first; a car does not change its bus, so when that fails the
+// ignition is most likely off and the adapter is left on auto search with
+// the cached protocol first. Otherwise the candidates are tried in order
+// of how common they are, each with a deadline fitting its bus init.
+class ProtocolDetector
+{
+public:
+    // Sends one command and returns the raw answer, "STOPPED" after deadline ms.
+    typedef std::function<QString(const QString &, int)> Request;
+    // Discards what the adapter still sends for the last command.
+    typedef std::function<void()> Drain;
+
+    ProtocolDetector();
+
+    // Returns the protocol number as in ATDPN without the auto prefix,
+    // empty when no ecu answered on any protocol.
+    QString detect(const Request &request, const Drain &drain, const QString &cached);
+
+    // Left on auto search, the adapter picks the protocol on the first
+    // request an ecu answers; its ATDPN then goes in with searched().
+    bool isSearching() const;
+    void searched(const QString &protocol);
+
+    QString protocol() const;
+    bool fromCache() const;
+    int probes() const;
+    qint64 elapsed() const;
+    QString summary() const;
+
+    // CAN first: nearly every car since 2008, then the older buses by share.
+    static QStringList fleetOrder();
+    // ms to wait for the first answer, slow buses need their 5 baud init
+    static int deadline(const QString &protocol);
+    // "A6\r\r>" or "6" -> "6", empty for anything else
+    static QString protocolNumber(const QString &answer);
+
+private:
+    bool probe(const Request &request, const Drain &drain, const QString &protocol);
+
+    QString m_protocol{};
+    bool m_fromCache{false};
+    bool m_searching{false};
+    bool m_fromSearch{false};
+    int m_probes{0};
+    qint64 m_elapsed{0};
+};
+
+#endif // PROTOCOLDETECTOR_H
@@ -0,0 +1,26 @@
+#include "reconnectbackoff.h"
+#include <QRandomGenerator>
+
+ReconnectBackoff::ReconnectBackoff()
+{
+}
+
+void ReconnectBackoff::reset()
+{
+    m_attempts = 0;
+}
+
+int ReconnectBackoff::next()
+{
+    int ceiling = BASE << std::min(m_attempts, 5);
+    if(ceiling > CAP)
+        ceiling = CAP;
+    m_attempts++;
+
+    return ceiling / 2 + static_cast<int>(QRandomGenerator::global()->bounded(ceiling / 2 + 1));
+}
+
+int ReconnectBackoff::attempts() const
+{
+    return m_attempts;
+}
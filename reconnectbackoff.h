@@ -0,0 +1,28 @@
+#ifndef RECONNECTBACKOFF_H
+#define RECONNECTBACKOFF_H
+
+#include <QtCore>
+
+// Delays between reconnect attempts after the link dropped. The first try
+// comes quickly, a wifi hiccup is over in a few hundred ms; each failure
+// doubles the ceiling up to CAP. The delay is drawn from the upper half
+// below the ceiling, so clients of an access point that restarted do not
+// all knock at the same moment.
+class ReconnectBackoff
+{
+public:
+    static const int BASE = 250;    // ms
+    static const int CAP = 5000;    // ms
+
+    ReconnectBackoff();
+
+    void reset();
+    // ms to wait before the next attempt
+    int next();
+    int attempts() const;
+
+private:
+    int m_attempts{0};
+};
+
+#endif // RECONNECTBACKOFF_H
@@ -0,0 +1,163 @@
+#include "responsecountlearner.h"
+
+namespace
+{
+const int STABLE_SAMPLES = 3;           // equal answers before a count is used
+const int RECHECK_EVERY = 50;           // suffixed requests between two unsuffixed
+}
+
+ResponseCountLearner::ResponseCountLearner()
+{
+}
+
+void ResponseCountLearner::reset()
+{
+    m_observed.clear();
+    m_counts.clear();
+    m_supported = true;
+}
+
+void ResponseCountLearner::setAdapterVersion(const QString &info)
+{
+    // "ELM327 v1.5", unknown strings are given the benefit of the doubt,
+    // a "?" answer to the first suffixed request still turns it off.
+    QRegularExpression version("v(\\d+)\\.(\\d+)", QRegularExpression::CaseInsensitiveOption);
+    QRegularExpressionMatch match = version.match(info);
+    if (!match.hasMatch())
+        return;
+
+    int major = match.captured(1).toInt();
+    int minor = match.captured(2).toInt();
+    m_supported = major > 1 || (major == 1 && minor >= 3);
+}
+
+bool ResponseCountLearner::isSupported() const
+{
+    return m_supported;
+}
+
+void ResponseCountLearner::setCounts(const QMap<QString, int> &counts)
+{
+    m_counts = counts;
+}
+
+QMap<QString, int> ResponseCountLearner::counts() const
+{
+    return m_counts;
+}
+
+QString ResponseCountLearner::prepare(const QString &command)
+{
+    if(!m_supported || !isServiceRequest(command))
+        return command;
+
+    int count = expected(command);
+    if(count < 1 || count > 9)
+        return command;
+
+    Observed &observed = m_observed[command];
+    if(observed.recheck || ++observed.suffixed >= RECHECK_EVERY)
+    {
+        observed.recheck = false;
+        observed.suffixed = 0;
+        return command;
+    }
+
+    return command + QString::number(count);
+}
+
+bool ResponseCountLearner::learn(const QString &command, const QString &request, const QByteArray &response)
+{
+    if(!isServiceRequest(command))
+        return false;
+
+    if(request != command && response.contains('?'))
+    {
+        // claims v1.3 but is not, requests go out as they are from now on
+        m_supported = false;
+        return false;
+    }
+
+    int count = countResponses(command, response);
+    if(request != command)
+    {
+        // NO DATA or a timeout: the ecus behind the count may have gone,
+        // the next one is sent without it
+        if(count == 0)
+            m_observed[command].recheck = true;
+        // otherwise the adapter stopped at the expected count, nothing new
+        return false;
+    }
+    if(count == 0)
+        return false;
+
+    Observed &observed = m_observed[command];
+    if(observed.samples > 0 && observed.count == count)
+    {
+        observed.samples++;
+    }
+    else
+    {
+        observed.count = count;
+        observed.samples = 1;
+    }
+
+    // the count in use cut an ecu off, no need to wait for it to repeat
+    int known = m_counts.value(command);
+    bool missed = known > 0 && count > known;
+    if((!missed && observed.samples < STABLE_SAMPLES) || known == observed.count)
+        return false;
+
+    m_counts[command] = observed.count;
+    return true;
+}
+
+int ResponseCountLearner::expected(const QString &command) const
+{
+    return m_counts.value(command, 0);
+}
+
+bool ResponseCountLearner::isServiceRequest(const QString &command)
+{
+    // service 01 pids, the ones polled in a loop
+    return command.length() == 4 && command.startsWith("01") && !command.startsWith("0100");
+}
+
+int ResponseCountLearner::countResponses(const QString &command, const QByteArray &response)
+{
+    if(command.length() < 4)
+        return 0;
+
+    // "41" and the pid, matched at the start of each line with spaces skipped
+    const char header[4] = {'4', '1', command.at(2).toUpper().toLatin1(),
+                            command.at(3).toUpper().toLatin1()};
+
+    int count = 0;
+    int matched = 0;
+    bool lineStart = true;
+    for(char c : response)
+    {
+        if(c == '\r')
+        {
+            matched = 0;
+            lineStart = true;
+            continue;
+        }
+        if(c == ' ' || !lineStart)
+            continue;
+
+        if(c >= 'a' && c <= 'z')
+            c -= 'a' - 'A';
+        if(c != header[matched])
+        {
+            lineStart = false;
+            continue;
+        }
+        if(++matched == 4)
+        {
+            count++;
+            lineStart = false;
+        }
+    }
+    return count;
+}
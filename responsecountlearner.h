@@ -0,0 +1,49 @@
+#ifndef RESPONSECOUNTLEARNER_H
+#define RESPONSECOUNTLEARNER_H
+
+#include <QtCore>
+
+// Learns how many ecus answer each service 01 request and appends that
+// count to the request (010C -> 010C1). ELM327 v1.3 and later then return
+// on the last answer instead of waiting for more until the timeout, which
+// on CAN saves the 50-100 ms after every reply.
+class ResponseCountLearner
+{
+public:
+    ResponseCountLearner();
+
+    void reset();
+
+    // Adapter firmware, the suffix needs v1.3 or later.
+    void setAdapterVersion(const QString &info);
+    bool isSupported() const;
+
+    // Counts from the vehicle profile, checked like learned ones.
+    void setCounts(const QMap<QString, int> &counts);
+    QMap<QString, int> counts() const;
+
+    // Now and then, and after a suffixed request got no answer, the
+    // request goes out without its count so a changed car is seen.
+    QString prepare(const QString &command);
+    // Feeds the answer of one request, true when a learned count changed.
+    bool learn(const QString &command, const QString &request, const QByteArray &response);
+    int expected(const QString &command) const;
+
+    static bool isServiceRequest(const QString &command);
+    static int countResponses(const QString &command, const QByteArray &response);
+
+private:
+    struct Observed
+    {
+        int count{0};
+        int samples{0};
+        int suffixed{0};        // sent with the count since the last check
+        bool recheck{false};
+    };
+
+    QHash<QString, Observed> m_observed{};
+    QMap<QString, int> m_counts{};
+    bool m_supported{true};
+};
+
+#endif // RESPONSECOUNTLEARNER_H
@@ -0,0 +1,327 @@
+#include "samplestore.h"
+#include <QSemaphore>
+#include <QThread>
+
+SampleRing::SampleRing(size_t capacity)
+{
+    size_t size = 1;
+    while(size < capacity)
+        size <<= 1;
+
+    m_slots.reset(new Slot[size]);
+    m_mask = size - 1;
+}
+
+size_t SampleRing::capacity() const
+{
+    return m_mask + 1;
+}
+
+void SampleRing::append(qint64 timestamp, double value)
+{
+    quint64 index = m_head.load(std::memory_order_relaxed);
+    Slot &slot = m_slots[index & m_mask];
+
+    // Invalidate the slot before touching its payload, readers check it twice.
+    slot.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.value.store(static_cast<float>(value), std::memory_order_relaxed);
+    slot.timestamp.store(timestamp, std::memory_order_relaxed);
+    slot.sequence.store(static_cast<quint32>(index + 1), std::memory_order_release);
+
+    m_head.store(index + 1, std::memory_order_release);
+}
+
+quint64 SampleRing::head() const
+{
+    return m_head.load(std::memory_order_acquire);
+}
+
+quint64 SampleRing::first() const
+{
+    quint64 written = head();
+    return written > capacity() ? written - capacity() : 0;
+}
+
+bool SampleRing::at(quint64 index, Sample &sample) const
+{
+    if(index >= head())
+        return false;
+
+    const Slot &slot = m_slots[index & m_mask];
+
+    quint32 sequence = slot.sequence.load(std::memory_order_acquire);
+    if(sequence != static_cast<quint32>(index + 1))
+        return false;
+
+    qint64 timestamp = slot.timestamp.load(std::memory_order_relaxed);
+    float value = slot.value.load(std::memory_order_relaxed);
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if(slot.sequence.load(std::memory_order_relaxed) != sequence)
+        return false;
+
+    sample.timestamp = timestamp;
+    sample.value = value;
+    return true;
+}
+
+bool SampleRing::latest(Sample &sample) const
+{
+    quint64 written = head();
+    return written > 0 && at(written - 1, sample);
+}
+
+quint64 SampleRing::lowerBound(qint64 timestamp) const
+{
+    quint64 low = first();
+    quint64 high = head();
+    Sample sample;
+
+    while(low < high)
+    {
+        quint64 middle = low + (high - low) / 2;
+
+        // A slot lost to the writer is older than anything still stored.
+        if(!at(middle, sample) || sample.timestamp < timestamp)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+MinMaxPyramid::MinMaxPyramid()
+{
+    // two points per bucket: 18 h at the two finest levels, days above
+    const size_t capacities[LEVELS] = {1 << 17, 1 << 14, 1 << 12, 1 << 10, 1 << 8};
+
+    for(int i = 0; i < LEVELS; i++)
+    {
+        m_levels[i].reset(new SampleRing(capacities[i]));
+    }
+}
+
+qint64 MinMaxPyramid::bucketDuration(int level) const
+{
+    return 1000LL << (3 * level);
+}
+
+const SampleRing *MinMaxPyramid::level(int level) const
+{
+    if(level < 0 || level >= LEVELS)
+        return nullptr;
+
+    return m_levels[level].get();
+}
+
+void MinMaxPyramid::append(qint64 timestamp, double value)
+{
+    Sample sample;
+    sample.timestamp = timestamp;
+    sample.value = value;
+    add(0, sample);
+}
+
+void MinMaxPyramid::add(int level, const Sample &sample)
+{
+    Bucket &bucket = m_buckets[level];
+    qint64 duration = bucketDuration(level);
+    qint64 start = sample.timestamp - sample.timestamp % duration;
+
+    if(!bucket.empty && start != bucket.start)
+        flush(level);
+
+    if(bucket.empty)
+    {
+        bucket.start = start;
+        bucket.minimum = sample;
+        bucket.maximum = sample;
+        bucket.empty = false;
+        return;
+    }
+
+    if(sample.value < bucket.minimum.value)
+        bucket.minimum = sample;
+    if(sample.value > bucket.maximum.value)
+        bucket.maximum = sample;
+}
+
+void MinMaxPyramid::flush(int level)
+{
+    Bucket &bucket = m_buckets[level];
+    const Sample &first = bucket.minimum.timestamp <= bucket.maximum.timestamp ? bucket.minimum : bucket.maximum;
+    const Sample &second = bucket.minimum.timestamp <= bucket.maximum.timestamp ? bucket.maximum : bucket.minimum;
+
+    m_levels[level]->append(first.timestamp, first.value);
+    if(second.timestamp != first.timestamp || second.value != first.value)
+        m_levels[level]->append(second.timestamp, second.value);
+
+    // The next level only needs the extremes of this one to stay exact.
+    Sample minimum = bucket.minimum;
+    Sample maximum = bucket.maximum;
+    bucket.empty = true;
+
+    if(level + 1 < LEVELS)
+    {
+        add(level + 1, minimum);
+        if(maximum.timestamp != minimum.timestamp)
+            add(level + 1, maximum);
+    }
+}
+
+// The acquisition thread and its queue: one producer, this one consumer.
+// A slot is free again once the thread has moved past it.
+class SampleStore::Writer : public QThread
+{
+public:
+    explicit Writer(SampleStore *store) :
+        m_store(store)
+    {
+    }
+
+    bool push(int channel, qint64 timestamp, double value)
+    {
+        quint64 head = m_head.load(std::memory_order_relaxed);
+        if(head - m_tail.load(std::memory_order_acquire) >= QUEUE)
+        {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        Entry &entry = m_queue[head & (QUEUE - 1)];
+        entry.channel = channel;
+        entry.timestamp = timestamp;
+        entry.value = value;
+        m_head.store(head + 1, std::memory_order_release);
+        m_pending.release();
+        return true;
+    }
+
+    void stop()
+    {
+        m_running = false;
+        m_pending.release();
+        wait();
+    }
+
+    quint64 dropped() const
+    {
+        return m_dropped.load(std::memory_order_relaxed);
+    }
+
+protected:
+    void run() override
+    {
+        while(true)
+        {
+            m_pending.acquire();
+
+            quint64 tail = m_tail.load(std::memory_order_relaxed);
+            if(tail == m_head.load(std::memory_order_acquire))
+            {
+                // the release of stop(), nothing queued
+                if(!m_running)
+                    return;
+                continue;
+            }
+
+            const Entry &entry = m_queue[tail & (QUEUE - 1)];
+            m_store->write(entry.channel, entry.timestamp, entry.value);
+            m_tail.store(tail + 1, std::memory_order_release);
+        }
+    }
+
+private:
+    struct Entry
+    {
+        int channel{0};
+        qint64 timestamp{0};
+        double value{0.0};
+    };
+
+    static const quint64 QUEUE = 4096;     // samples, a power of two
+
+    SampleStore *m_store{};
+    std::array<Entry, QUEUE> m_queue{};
+    alignas(64) std::atomic<quint64> m_head{0};
+    alignas(64) std::atomic<quint64> m_tail{0};
+    std::atomic<quint64> m_dropped{0};
+    std::atomic<bool> m_running{true};
+    QSemaphore m_pending{};
+};
+
+SampleStore* SampleStore::theInstance_ = nullptr;
+
+SampleStore *SampleStore::getInstance()
+{
+    if (theInstance_ == nullptr)
+    {
+        theInstance_ = new SampleStore();
+    }
+    return theInstance_;
+}
+
+SampleStore::SampleStore()
+{
+    const int charted[] = {CH_ENGINE_RPM, CH_MAN_ABSOLUTE_PRESSURE, CH_VEHICLE_SPEED, CH_COOLANT_TEMP,
+                           CH_ENGINE_LOAD, CH_VOLTAGE, CH_BOOST, CH_FUEL_FLOW, CH_INSTANT_CONSUMPTION};
+
+    for(int channel : charted)
+    {
+        reserve(channel, DEFAULT_CAPACITY);
+    }
+
+    m_writer.reset(new Writer(this));
+    m_writer->start();
+}
+
+SampleStore::~SampleStore()
+{
+    m_writer->stop();
+}
+
+void SampleStore::reserve(int channel, size_t capacity)
+{
+    if(channel < 0 || channel >= CH_COUNT || m_rings[channel])
+        return;
+
+    m_rings[channel].reset(new SampleRing(capacity));
+    m_pyramids[channel].reset(new MinMaxPyramid());
+}
+
+void SampleStore::append(int channel, qint64 timestamp, double value)
+{
+    if(channel < 0 || channel >= CH_COUNT || !m_rings[channel])
+        return;
+
+    m_writer->push(channel, timestamp, value);
+}
+
+void SampleStore::write(int channel, qint64 timestamp, double value)
+{
+    m_rings[channel]->append(timestamp, value);
+    m_pyramids[channel]->append(timestamp, value);
+}
+
+const SampleRing *SampleStore::ring(int channel) const
+{
+    if(channel < 0 || channel >= CH_COUNT)
+        return nullptr;
+
+    return m_rings[channel].get();
+}
+
+const MinMaxPyramid *SampleStore::pyramid(int channel) const
+{
+    if(channel < 0 || channel >= CH_COUNT)
+        return nullptr;
+
+    return m_pyramids[channel].get();
+}
+
+quint64 SampleStore::dropped() const
+{
+    return m_writer->dropped();
+}
@@ -0,0 +1,147 @@
+#ifndef SAMPLESTORE_H
+#define SAMPLESTORE_H
+
+#include <QtGlobal>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "global.h"
+
+struct Sample
+{
+    qint64 timestamp{0};    // ms since epoch
+    double value{0.0};
+};
+
+// Fixed-capacity history of one channel.
+// One thread appends, any number of threads read without locks: every slot
+// carries a sequence number, a reader that sees it change while copying the
+// slot knows the writer lapped it and drops that sample.
+class SampleRing
+{
+public:
+    explicit SampleRing(size_t capacity);
+
+    size_t capacity() const;
+
+    // Writer side, O(1) and allocation free.
+    void append(qint64 timestamp, double value);
+
+    // Number of samples ever appended; valid indexes are [first(), head()).
+    quint64 head() const;
+    quint64 first() const;
+
+    bool at(quint64 index, Sample &sample) const;
+    bool latest(Sample &sample) const;
+
+    // First index whose timestamp is >= timestamp.
+    quint64 lowerBound(qint64 timestamp) const;
+
+    // Visits [from, to) in place, skipping slots overwritten meanwhile.
+    template<class F>
+    quint64 forEach(quint64 from, quint64 to, F visit) const
+    {
+        quint64 visited = 0;
+        Sample sample;
+
+        from = std::max(from, first());
+        to = std::min(to, head());
+
+        for(quint64 index = from; index < to; index++)
+        {
+            if(at(index, sample))
+            {
+                visit(index, sample);
+                visited++;
+            }
+        }
+        return visited;
+    }
+
+private:
+    // 16 bytes, four slots per cache line. Values are stored as float,
+    // which is wider than any Service 01 encoding.
+    struct Slot
+    {
+        std::atomic<quint32> sequence{0};
+        std::atomic<float> value{0.0f};
+        std::atomic<qint64> timestamp{0};
+    };
+
+    std::unique_ptr<Slot[]> m_slots;
+    size_t m_mask;
+    alignas(64) std::atomic<quint64> m_head{0};
+};
+
+// Min/max envelope of one channel at several time resolutions.
+// Level n buckets span 1 s * 8^n; every closed bucket stores its minimum and
+// maximum sample, in time order, into a SampleRing of its own. Readers get
+// the same lock-free access as to the raw history. The open bucket of each
+// level is not visible until it closes.
+class MinMaxPyramid
+{
+public:
+    MinMaxPyramid();
+
+    void append(qint64 timestamp, double value);
+
+    qint64 bucketDuration(int level) const;
+    const SampleRing *level(int level) const;
+
+    static const int LEVELS = 5;    // 1 s, 8 s, 64 s, 512 s, 4096 s
+
+private:
+    struct Bucket
+    {
+        qint64 start{0};
+        Sample minimum{};
+        Sample maximum{};
+        bool empty{true};
+    };
+
+    void add(int level, const Sample &sample);
+    void flush(int level);
+
+    std::array<std::unique_ptr<SampleRing>, LEVELS> m_levels{};
+    std::array<Bucket, LEVELS> m_buckets{};
+};
+
+// Per-channel rings, allocated once at startup.
+// The rings have one writer, the store's acquisition thread. The decode
+// path hands samples over through a fixed queue and never waits for a
+// ring, a pyramid cascade or a reader.
+class SampleStore
+{
+public:
+    SampleStore();
+    ~SampleStore();
+    static SampleStore* getInstance();
+
+    // Call before acquisition starts; appends to channels without a ring are dropped.
+    void reserve(int channel, size_t capacity);
+
+    // One producer thread; O(1), allocation free. Dropped when the
+    // acquisition thread is a whole queue behind.
+    void append(int channel, qint64 timestamp, double value);
+    const SampleRing *ring(int channel) const;
+    const MinMaxPyramid *pyramid(int channel) const;
+    quint64 dropped() const;
+
+    static const size_t DEFAULT_CAPACITY = 1 << 18;  // 3.6 h at 20 Hz
+
+private:
+    class Writer;
+
+    // acquisition thread only
+    void write(int channel, qint64 timestamp, double value);
+
+    std::array<std::unique_ptr<SampleRing>, CH_COUNT> m_rings{};
+    std::array<std::unique_ptr<MinMaxPyramid>, CH_COUNT> m_pyramids{};
+    std::unique_ptr<Writer> m_writer;
+
+    static SampleStore* theInstance_;
+};
+
+#endif // SAMPLESTORE_H
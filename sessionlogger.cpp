@@ -0,0 +1,55 @@
+#include "sessionlogger.h"
+
+SessionLogger::SessionLogger(const QString &session, QObject *parent) :
+    QObject(parent)
+{
+    // "192.168.0.10:35000" started now, one file per session and run
+    QString name = session;
+    name.replace(QRegExp("[^A-Za-z0-9]"), "_");
+    QString directory = QDir::currentPath() + "/sessions";
+    QDir().mkpath(directory);
+    m_fileName = directory + "/" + name + "_" +
+            QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss") + ".csv";
+}
+
+SessionLogger::~SessionLogger()
+{
+    close();
+}
+
+QString SessionLogger::fileName() const
+{
+    return m_fileName;
+}
+
+quint64 SessionLogger::lines() const
+{
+    return m_lines;
+}
+
+void SessionLogger::sampled(int pid, uint A, uint B, qint64 timestamp)
+{
+    if(!m_file.isOpen())
+    {
+        m_file.setFileName(m_fileName);
+        if(!m_file.open(QIODevice::WriteOnly | QIODevice::Text))
+            return;
+
+        m_stream.setDevice(&m_file);
+        m_stream << "timestamp,channel,pid,A,B\n";
+    }
+
+    m_stream << timestamp << ',' << channelName(pid) << ','
+             << QString("%1").arg(pid, 2, 16, QLatin1Char('0')).toUpper() << ',' << A << ',' << B << '\n';
+    m_lines++;
+}
+
+void SessionLogger::close()
+{
+    if(!m_file.isOpen())
+        return;
+
+    m_stream.flush();
+    m_stream.setDevice(nullptr);
+    m_file.close();
+}
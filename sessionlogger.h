@@ -0,0 +1,37 @@
+#ifndef SESSIONLOGGER_H
+#define SESSIONLOGGER_H
+
+#include <QObject>
+#include <QFile>
+#include <QTextStream>
+#include <atomic>
+#include "global.h"
+
+// Writes the samples of one ElmSession to a csv of its own. It lives on
+// the session's thread, so each vehicle is logged beside the others
+// without a lock. The file is made on the first sample; the name is fixed
+// at construction and may be read from any thread.
+class SessionLogger : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SessionLogger(const QString &session, QObject *parent = nullptr);
+    ~SessionLogger() override;
+
+    QString fileName() const;
+    quint64 lines() const;
+
+public slots:
+    // raw data bytes as decoded by ELM::decodePid
+    void sampled(int pid, uint A, uint B, qint64 timestamp);
+    void close();
+
+private:
+    QString m_fileName{};
+    QFile m_file{};
+    QTextStream m_stream{};
+    std::atomic<quint64> m_lines{0};
+};
+
+#endif // SESSIONLOGGER_H
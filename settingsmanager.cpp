@@ -26,6 +26,7 @@ void SettingsManager::loadSettings()
     WifiPort = settings.value("WifiPort", "").toString().toUShort();
     BleAddress = QBluetoothAddress(settings.value("BleAddress", "").toString());
     SerialPort = settings.value("SerialPort", "").toString();
+    WireProfile = settings.value("WireProfile", "compact").toString();
 }
 
 void SettingsManager::saveSettings()
@@ -36,6 +37,7 @@ void SettingsManager::saveSettings()
     settings.setValue("WifiPort", QString::number(WifiPort));
     settings.setValue("BleAddress", BleAddress.toString());
     settings.setValue("SerialPort", SerialPort);
+    settings.setValue("WireProfile", WireProfile);
 }
 
 unsigned int SettingsManager::getEngineDisplacement() const
@@ -88,4 +90,12 @@ void SettingsManager::setSerialPort(const QString &value)
     SerialPort = value;
 }
 
+void SettingsManager::setWireProfile(const QString &value)
+{
+    WireProfile = value;
+}
 
+QString SettingsManager::getWireProfile() const
+{
+    return WireProfile;
+}
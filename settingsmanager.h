@@ -31,6 +31,10 @@ public:
     void setSerialPort(const QString &value);
     QString getSerialPort() const;
 
+    // "compact" or "readable", see WireProfile
+    void setWireProfile(const QString &value);
+    QString getWireProfile() const;
+
 private:
     static SettingsManager* theInstance_;
     QString m_sSettingsFile{};
@@ -39,6 +43,7 @@ private:
     quint16 WifiPort{35000};
     QBluetoothAddress BleAddress{};
     QString SerialPort{};
+    QString WireProfile{"compact"};
 
 };
 
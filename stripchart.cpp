@@ -0,0 +1,206 @@
+#include "stripchart.h"
+#include "downsample.h"
+#include <QPainter>
+#include <QPaintEvent>
+#include <QResizeEvent>
+
+StripChart::StripChart(QWidget *parent) :
+    QWidget(parent),
+    m_store(SampleStore::getInstance())
+{
+    // The pixmap covers the whole widget, nothing underneath needs painting.
+    setAttribute(Qt::WA_OpaquePaintEvent);
+    setMinimumHeight(120);
+}
+
+void StripChart::addTrace(int channel, const QColor &color, double minimum, double maximum)
+{
+    m_traces.push_back(Trace{channel, color, minimum, maximum, 0, QPointF(), false});
+    redraw();
+}
+
+void StripChart::setTimeSpan(int milliseconds)
+{
+    m_timeSpan = qMax(1000, milliseconds);
+    redraw();
+}
+
+void StripChart::setFrameInterval(int milliseconds)
+{
+    m_frameInterval = milliseconds;
+    if(m_timerId)
+    {
+        stop();
+        start();
+    }
+}
+
+void StripChart::start()
+{
+    if(!m_timerId)
+        m_timerId = startTimer(m_frameInterval);
+}
+
+void StripChart::stop()
+{
+    if(m_timerId)
+        killTimer(m_timerId);
+    m_timerId = 0;
+}
+
+void StripChart::paintEvent(QPaintEvent *event)
+{
+    Q_UNUSED(event)
+
+    QPainter painter(this);
+    painter.drawPixmap(0, 0, m_pixmap);
+}
+
+void StripChart::resizeEvent(QResizeEvent *event)
+{
+    Q_UNUSED(event)
+
+    m_pixmap = QPixmap(size());
+    redraw();
+}
+
+void StripChart::timerEvent(QTimerEvent *event)
+{
+    Q_UNUSED(event)
+
+    advance(currentTimeMillis());
+}
+
+void StripChart::redraw()
+{
+    if(m_pixmap.isNull())
+        return;
+
+    qint64 now = currentTimeMillis();
+    m_rightEdge = now;
+    clearColumns(0, m_pixmap.width());
+
+    // The visible history is drawn once from about one point per column,
+    // the next frames only append what arrives after it.
+    QPainter painter(&m_pixmap);
+    painter.setRenderHint(QPainter::Antialiasing);
+
+    for(auto &trace : m_traces)
+    {
+        trace.hasLast = false;
+        trace.next = 0;
+
+        const SampleRing *ring = m_store->ring(trace.channel);
+        if(!ring)
+            continue;
+
+        trace.next = ring->head();
+        painter.setPen(QPen(trace.color, 2));
+
+        for(const Sample &sample : Downsample::window(m_store, trace.channel, now - m_timeSpan, now, m_pixmap.width()))
+        {
+            QPointF point = toPoint(trace, sample);
+            if(trace.hasLast)
+                painter.drawLine(trace.last, point);
+
+            trace.last = point;
+            trace.hasLast = true;
+        }
+    }
+    painter.end();
+
+    update();
+}
+
+void StripChart::advance(qint64 now)
+{
+    int width = m_pixmap.width();
+    if(width <= 0)
+        return;
+
+    double msPerPixel = static_cast<double>(m_timeSpan) / width;
+    int dx = static_cast<int>((now - m_rightEdge) / msPerPixel);
+
+    if(dx >= width)
+    {
+        redraw();
+        return;
+    }
+
+    if(dx > 0)
+    {
+        m_pixmap.scroll(-dx, 0, m_pixmap.rect());
+        clearColumns(width - dx, width);
+        m_rightEdge += static_cast<qint64>(dx * msPerPixel);
+
+        for(auto &trace : m_traces)
+        {
+            trace.last.rx() -= dx;
+        }
+    }
+
+    for(auto &trace : m_traces)
+    {
+        drawNewSamples(trace);
+    }
+
+    update();
+}
+
+void StripChart::drawNewSamples(Trace &trace)
+{
+    const SampleRing *ring = m_store->ring(trace.channel);
+    if(!ring)
+        return;
+
+    quint64 head = ring->head();
+    if(trace.next >= head)
+        return;
+
+    QPainter painter(&m_pixmap);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setPen(QPen(trace.color, 2));
+
+    ring->forEach(trace.next, head, [&](quint64, const Sample &sample)
+    {
+        QPointF point = toPoint(trace, sample);
+        if(trace.hasLast)
+            painter.drawLine(trace.last, point);
+        else
+            painter.drawPoint(point);
+
+        trace.last = point;
+        trace.hasLast = true;
+    });
+
+    trace.next = head;
+}
+
+void StripChart::clearColumns(int from, int to)
+{
+    int height = m_pixmap.height();
+
+    QPainter painter(&m_pixmap);
+    painter.fillRect(from, 0, to - from, height, m_background);
+
+    painter.setPen(QPen(m_grid, 1));
+    for(int i = 1; i < 4; i++)
+    {
+        int y = height * i / 4;
+        painter.drawLine(from, y, to, y);
+    }
+}
+
+QPointF StripChart::toPoint(const Trace &trace, const Sample &sample) const
+{
+    int width = m_pixmap.width();
+    int height = m_pixmap.height();
+    double msPerPixel = static_cast<double>(m_timeSpan) / width;
+
+    double x = (width - 1) - (m_rightEdge - sample.timestamp) / msPerPixel;
+    double range = trace.maximum - trace.minimum;
+    double ratio = range > 0 ? (sample.value - trace.minimum) / range : 0.0;
+    double y = (height - 1) * (1.0 - qBound(0.0, ratio, 1.0));
+
+    return QPointF(x, y);
+}
@@ -0,0 +1,62 @@
+#ifndef STRIPCHART_H
+#define STRIPCHART_H
+
+#include <QWidget>
+#include <QPixmap>
+#include <QColor>
+#include <vector>
+#include "samplestore.h"
+
+// Scrolling time history of a few channels.
+// Every frame the backing pixmap is scrolled left by the elapsed time and
+// only the samples that arrived since the last frame are drawn on it.
+class StripChart : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit StripChart(QWidget *parent = nullptr);
+
+    void addTrace(int channel, const QColor &color, double minimum, double maximum);
+    void setTimeSpan(int milliseconds);
+    void setFrameInterval(int milliseconds);
+
+    void start();
+    void stop();
+
+protected:
+    void paintEvent(QPaintEvent *) override;
+    void resizeEvent(QResizeEvent *) override;
+    void timerEvent(QTimerEvent *) override;
+
+private:
+    struct Trace
+    {
+        int channel;
+        QColor color;
+        double minimum;
+        double maximum;
+        quint64 next;       // next ring index to draw
+        QPointF last;
+        bool hasLast;
+    };
+
+    void redraw();
+    void advance(qint64 now);
+    void drawNewSamples(Trace &trace);
+    void clearColumns(int from, int to);
+    QPointF toPoint(const Trace &trace, const Sample &sample) const;
+
+    SampleStore *m_store{};
+    std::vector<Trace> m_traces{};
+    QPixmap m_pixmap{};
+    QColor m_background{"#001a1a"};
+    QColor m_grid{"#0B5345"};
+
+    int m_timeSpan{60000};          // ms across the widget
+    int m_frameInterval{40};        // ms
+    int m_timerId{0};
+    qint64 m_rightEdge{0};          // timestamp of the rightmost column
+};
+
+#endif // STRIPCHART_H
@@ -0,0 +1,206 @@
+#include "tdigest.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+TDigest::TDigest(double compression) :
+    m_compression(compression),
+    m_bufferCapacity(static_cast<size_t>(compression * 5))
+{
+    m_centroids.reserve(static_cast<size_t>(compression * 2) + 8);
+    m_buffer.reserve(m_bufferCapacity);
+    m_scratch.reserve(m_bufferCapacity + m_centroids.capacity());
+}
+
+void TDigest::add(double value, double weight)
+{
+    if(weight <= 0.0 || std::isnan(value))
+        return;
+
+    if(m_totalWeight == 0.0)
+    {
+        m_min = value;
+        m_max = value;
+    }
+    else
+    {
+        m_min = std::min(m_min, value);
+        m_max = std::max(m_max, value);
+    }
+
+    m_totalWeight += weight;
+    m_buffer.push_back(Centroid{value, weight});
+
+    if(m_buffer.size() >= m_bufferCapacity)
+        compress();
+}
+
+void TDigest::merge(const TDigest &other)
+{
+    if(other.isEmpty())
+        return;
+
+    other.compress();
+
+    double otherMin = other.m_min;
+    double otherMax = other.m_max;
+
+    for(const auto &centroid : other.m_centroids)
+    {
+        add(centroid.mean, centroid.weight);
+    }
+
+    // centroid means lie inside the range, the true extremes come from other
+    m_min = std::min(m_min, otherMin);
+    m_max = std::max(m_max, otherMax);
+}
+
+void TDigest::clear()
+{
+    m_centroids.clear();
+    m_buffer.clear();
+    m_totalWeight = 0.0;
+    m_min = 0.0;
+    m_max = 0.0;
+}
+
+void TDigest::compress() const
+{
+    if(m_buffer.empty())
+        return;
+
+    m_scratch.clear();
+    m_scratch.insert(m_scratch.end(), m_centroids.begin(), m_centroids.end());
+    m_scratch.insert(m_scratch.end(), m_buffer.begin(), m_buffer.end());
+    m_buffer.clear();
+
+    std::sort(m_scratch.begin(), m_scratch.end(), [](const Centroid &a, const Centroid &b)
+    {
+        return a.mean < b.mean;
+    });
+
+    m_centroids.clear();
+    m_centroids.push_back(m_scratch.front());
+    double cumulative = 0.0;
+
+    for(size_t i = 1; i < m_scratch.size(); i++)
+    {
+        Centroid &current = m_centroids.back();
+        const Centroid &next = m_scratch[i];
+
+        // k0-style bound: centroids stay small near the tails
+        double q = (cumulative + (current.weight + next.weight) / 2.0) / m_totalWeight;
+        double limit = std::max(1.0, 4.0 * m_totalWeight * q * (1.0 - q) / m_compression);
+
+        if(current.weight + next.weight <= limit)
+        {
+            double weight = current.weight + next.weight;
+            current.mean += (next.mean - current.mean) * next.weight / weight;
+            current.weight = weight;
+        }
+        else
+        {
+            cumulative += current.weight;
+            m_centroids.push_back(next);
+        }
+    }
+}
+
+double TDigest::quantile(double q) const
+{
+    if(isEmpty())
+        return std::numeric_limits<double>::quiet_NaN();
+
+    compress();
+
+    q = std::min(1.0, std::max(0.0, q));
+    if(m_centroids.size() == 1)
+        return m_centroids.front().mean;
+
+    double rank = q * m_totalWeight;
+
+    // Each centroid sits at the middle of the weight it covers; interpolate
+    // between neighbours and fall back to min/max at the ends.
+    double cumulative = 0.0;
+    for(size_t i = 0; i < m_centroids.size(); i++)
+    {
+        const Centroid &centroid = m_centroids[i];
+        double center = cumulative + centroid.weight / 2.0;
+
+        if(rank < center)
+        {
+            if(i == 0)
+            {
+                double ratio = centroid.weight > 0 ? rank / center : 0.0;
+                return m_min + (centroid.mean - m_min) * ratio;
+            }
+
+            const Centroid &previous = m_centroids[i - 1];
+            double previousCenter = cumulative - previous.weight / 2.0;
+            double ratio = (rank - previousCenter) / (center - previousCenter);
+            return previous.mean + (centroid.mean - previous.mean) * ratio;
+        }
+        cumulative += centroid.weight;
+    }
+
+    const Centroid &last = m_centroids.back();
+    double lastCenter = m_totalWeight - last.weight / 2.0;
+    double ratio = (rank - lastCenter) / (m_totalWeight - lastCenter);
+    return last.mean + (m_max - last.mean) * std::min(1.0, ratio);
+}
+
+double TDigest::totalWeight() const
+{
+    return m_totalWeight;
+}
+
+double TDigest::min() const
+{
+    return m_min;
+}
+
+double TDigest::max() const
+{
+    return m_max;
+}
+
+bool TDigest::isEmpty() const
+{
+    return m_totalWeight <= 0.0;
+}
+
+QString TDigest::serialize() const
+{
+    compress();
+
+    QString text = QString::number(m_min, 'g', 10) + " " + QString::number(m_max, 'g', 10);
+    for(const auto &centroid : m_centroids)
+    {
+        text.append(";" + QString::number(centroid.mean, 'g', 10) + ":" + QString::number(centroid.weight, 'g', 10));
+    }
+    return text;
+}
+
+TDigest TDigest::deserialize(const QString &text, double compression)
+{
+    TDigest digest(compression);
+
+    auto parts = text.split(";");
+    if(parts.isEmpty() || parts[0].isEmpty())
+        return digest;
+
+    for(int i = 1; i < parts.size(); i++)
+    {
+        auto pair = parts[i].split(":");
+        if(pair.size() == 2)
+            digest.add(pair[0].toDouble(), pair[1].toDouble());
+    }
+
+    auto range = parts[0].split(" ");
+    if(range.size() == 2 && !digest.isEmpty())
+    {
+        digest.m_min = range[0].toDouble();
+        digest.m_max = range[1].toDouble();
+    }
+    return digest;
+}
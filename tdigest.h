@@ -0,0 +1,51 @@
+#ifndef TDIGEST_H
+#define TDIGEST_H
+
+#include <QtCore>
+#include <vector>
+
+// Merging t-digest (Dunning). Quantile sketch in constant memory: at most
+// about 2 * compression centroids plus a fixed insert buffer. Digests of
+// different trips or vehicles merge without loss of the bound.
+class TDigest
+{
+public:
+    explicit TDigest(double compression = 100.0);
+
+    void add(double value, double weight = 1.0);
+    void merge(const TDigest &other);
+    void clear();
+
+    double quantile(double q) const;
+    double totalWeight() const;
+    double min() const;
+    double max() const;
+    bool isEmpty() const;
+
+    // "min max;mean:weight;mean:weight;..." for summary files
+    QString serialize() const;
+    static TDigest deserialize(const QString &text, double compression = 100.0);
+
+private:
+    struct Centroid
+    {
+        double mean;
+        double weight;
+    };
+
+    void compress() const;
+
+    double m_compression;
+    size_t m_bufferCapacity;
+
+    // compress() only folds the buffer in, the digest it describes is unchanged
+    mutable std::vector<Centroid> m_centroids{};
+    mutable std::vector<Centroid> m_buffer{};
+    mutable std::vector<Centroid> m_scratch{};
+
+    double m_totalWeight{0.0};
+    double m_min{0.0};
+    double m_max{0.0};
+};
+
+#endif // TDIGEST_H
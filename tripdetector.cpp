@@ -0,0 +1,132 @@
+#include "tripdetector.h"
+#include "derivedchannels.h"
+
+namespace
+{
+const double RUNNING_RPM = 400.0;
+const double CHARGING_VOLTAGE = 13.2;   // alternator output, engine turning
+const qint64 RPM_STALE = 10000;         // ms, older rpm values are not trusted
+const int NO_DATA_LIMIT = 5;            // missed requests before the ecu counts as asleep
+const qint64 STOP_HOLD = 60000;         // ms the engine must stay off to end a trip
+}
+
+TripDetector* TripDetector::theInstance_ = nullptr;
+
+TripDetector *TripDetector::getInstance()
+{
+    if (theInstance_ == nullptr)
+    {
+        theInstance_ = new TripDetector();
+    }
+    return theInstance_;
+}
+
+TripDetector::TripDetector(QObject *parent) :
+    QObject(parent)
+{
+    connect(DerivedChannels::getInstance(), &DerivedChannels::channelUpdated, this, &TripDetector::channelUpdated);
+}
+
+TripDetector::State TripDetector::state() const
+{
+    return m_state;
+}
+
+bool TripDetector::isParked() const
+{
+    return m_state == Parked;
+}
+
+bool TripDetector::isIdle() const
+{
+    return m_state == Parked || m_state == IgnitionOn;
+}
+
+bool TripDetector::inTrip() const
+{
+    return m_inTrip;
+}
+
+void TripDetector::noData(qint64 timestamp)
+{
+    m_noDataStreak++;
+    evaluate(timestamp);
+}
+
+void TripDetector::finishTrip(qint64 timestamp)
+{
+    if(!m_inTrip)
+        return;
+
+    m_inTrip = false;
+    emit tripEnded(m_engineOffSince ? m_engineOffSince : timestamp);
+    m_engineOffSince = 0;
+}
+
+void TripDetector::channelUpdated(int channel, double value, qint64 timestamp)
+{
+    if(channel == CH_VOLTAGE)
+    {
+        m_voltage = value;
+    }
+    else if(channel < CH_VOLTAGE)
+    {
+        // any decoded pid means the ecu is awake
+        m_noDataStreak = 0;
+        if(channel == CH_ENGINE_RPM)
+        {
+            m_rpm = value;
+            m_rpmTimestamp = timestamp;
+        }
+    }
+    else
+    {
+        return;
+    }
+
+    evaluate(timestamp);
+}
+
+void TripDetector::evaluate(qint64 timestamp)
+{
+    bool rpmFresh = m_rpmTimestamp > 0 && timestamp - m_rpmTimestamp <= RPM_STALE;
+    bool ecuAwake = m_noDataStreak < NO_DATA_LIMIT;
+
+    // rpm decides when it is there, the charging voltage covers the gaps
+    bool running = rpmFresh ? m_rpm >= RUNNING_RPM : m_voltage >= CHARGING_VOLTAGE;
+
+    State state = Parked;
+    if(running)
+        state = EngineRunning;
+    else if(ecuAwake)
+        state = IgnitionOn;
+
+    if(state == EngineRunning)
+    {
+        m_engineOffSince = 0;
+        if(!m_inTrip)
+        {
+            m_inTrip = true;
+            emit tripStarted(timestamp);
+        }
+    }
+    else if(m_inTrip)
+    {
+        if(m_engineOffSince == 0)
+            m_engineOffSince = timestamp;
+
+        // a stall or a start-stop pause stays in the same trip
+        if(state == Parked || timestamp - m_engineOffSince >= STOP_HOLD)
+        {
+            m_inTrip = false;
+            emit tripEnded(m_engineOffSince);
+            m_engineOffSince = 0;
+        }
+    }
+
+    if(state != m_state)
+    {
+        m_state = state;
+        emit stateChanged(m_state);
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef TRIPDETECTOR_H
+#define TRIPDETECTOR_H
+
+#include <QObject>
+#include "global.h"
+
+// Tells from the polled data whether the car is parked, has the ignition on
+// or has the engine running, and cuts the stream into trips. The adapter
+// stays powered while parked, so a trip ends on the engine stopping rather
+// than on the connection going away.
+class TripDetector : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum State
+    {
+        Unknown,            // nothing decoded yet
+        Parked,             // ecu asleep, only the adapter answers
+        IgnitionOn,         // ecu answers, engine not turning
+        EngineRunning
+    };
+
+    explicit TripDetector(QObject *parent = nullptr);
+    static TripDetector* getInstance();
+
+    State state() const;
+    bool isParked() const;
+    // Engine off, whether the ecu still answers or not.
+    bool isIdle() const;
+    bool inTrip() const;
+
+    // A mode 01 request got NO DATA or UNABLE TO CONNECT.
+    void noData(qint64 timestamp);
+    // The app exits, close the running trip. A view closing is no end:
+    // the drive goes on and the next view continues the same trip.
+    void finishTrip(qint64 timestamp);
+
+signals:
+    void stateChanged(int state);
+    void tripStarted(qint64 timestamp);
+    void tripEnded(qint64 timestamp);
+
+public slots:
+    void channelUpdated(int channel, double value, qint64 timestamp);
+
+private:
+    void evaluate(qint64 timestamp);
+
+    State m_state{Unknown};
+    bool m_inTrip{false};
+
+    double m_rpm{0.0};
+    qint64 m_rpmTimestamp{0};
+    double m_voltage{0.0};
+    int m_noDataStreak{0};
+    qint64 m_engineOffSince{0};
+
+    static TripDetector* theInstance_;
+};
+
+#endif // TRIPDETECTOR_H
@@ -0,0 +1,80 @@
+#include "triplogger.h"
+#include "tripdetector.h"
+#include "tripstatistics.h"
+#include "derivedchannels.h"
+
+TripLogger* TripLogger::theInstance_ = nullptr;
+
+TripLogger *TripLogger::getInstance()
+{
+    if (theInstance_ == nullptr)
+    {
+        theInstance_ = new TripLogger();
+    }
+    return theInstance_;
+}
+
+TripLogger::TripLogger(QObject *parent) :
+    QObject(parent)
+{
+    TripDetector *detector = TripDetector::getInstance();
+    connect(detector, &TripDetector::tripStarted, this, &TripLogger::tripStarted);
+    connect(detector, &TripDetector::tripEnded, this, &TripLogger::tripEnded);
+    connect(DerivedChannels::getInstance(), &DerivedChannels::channelUpdated, this, &TripLogger::channelUpdated);
+}
+
+TripLogger::~TripLogger()
+{
+    closeSegment();
+}
+
+bool TripLogger::isLogging() const
+{
+    return m_file.isOpen();
+}
+
+QString TripLogger::currentFile() const
+{
+    return m_file.fileName();
+}
+
+void TripLogger::tripStarted(qint64 timestamp)
+{
+    closeSegment();
+
+    TripStatistics *statistics = TripStatistics::getInstance();
+    statistics->startTrip(timestamp);
+
+    // Same base name as the summary the statistics write at the end.
+    QDir().mkpath(statistics->directory());
+    m_file.setFileName(statistics->directory() + "/trip_" + QDateTime::fromMSecsSinceEpoch(timestamp).toString("yyyyMMdd_hhmmss") + ".csv");
+    if(!m_file.open(QIODevice::WriteOnly | QIODevice::Text))
+        return;
+
+    m_stream.setDevice(&m_file);
+    m_stream << "timestamp,channel,value\n";
+}
+
+void TripLogger::tripEnded(qint64 timestamp)
+{
+    closeSegment();
+    TripStatistics::getInstance()->finishTrip(timestamp);
+}
+
+void TripLogger::channelUpdated(int channel, double value, qint64 timestamp)
+{
+    if(!m_file.isOpen())
+        return;
+
+    m_stream << timestamp << ',' << channelName(channel) << ',' << value << '\n';
+}
+
+void TripLogger::closeSegment()
+{
+    if(!m_file.isOpen())
+        return;
+
+    m_stream.flush();
+    m_stream.setDevice(nullptr);
+    m_file.close();
+}
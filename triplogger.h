@@ -0,0 +1,38 @@
+#ifndef TRIPLOGGER_H
+#define TRIPLOGGER_H
+
+#include <QObject>
+#include <QFile>
+#include <QTextStream>
+#include "global.h"
+
+// Writes every channel update of a trip to its own csv segment next to the
+// trip summary. Segments are opened and closed by the TripDetector, so a
+// parked car produces no log at all.
+class TripLogger : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TripLogger(QObject *parent = nullptr);
+    ~TripLogger() override;
+    static TripLogger* getInstance();
+
+    bool isLogging() const;
+    QString currentFile() const;
+
+public slots:
+    void tripStarted(qint64 timestamp);
+    void tripEnded(qint64 timestamp);
+    void channelUpdated(int channel, double value, qint64 timestamp);
+
+private:
+    void closeSegment();
+
+    QFile m_file{};
+    QTextStream m_stream{};
+
+    static TripLogger* theInstance_;
+};
+
+#endif // TRIPLOGGER_H
@@ -0,0 +1,346 @@
+#include "tripstatistics.h"
+#include "derivedchannels.h"
+#include <QSettings>
+#include <algorithm>
+
+namespace
+{
+const qint64 MAX_HOLD = 5000;   // ms, longer gaps are not counted
+}
+
+double TripStatistics::ChannelStatistics::mean() const
+{
+    if(seconds > 0.0)
+        return weightedSum.value() / seconds;
+
+    return count > 0 ? lastValue : 0.0;
+}
+
+TripStatistics* TripStatistics::theInstance_ = nullptr;
+
+TripStatistics *TripStatistics::getInstance()
+{
+    if (theInstance_ == nullptr)
+    {
+        theInstance_ = new TripStatistics();
+    }
+    return theInstance_;
+}
+
+TripStatistics::TripStatistics(QObject *parent) :
+    QObject(parent)
+{
+    m_directory = QDir::currentPath() + "/trips";
+    connect(DerivedChannels::getInstance(), &DerivedChannels::channelUpdated, this, &TripStatistics::channelUpdated);
+
+    addBand(CH_COOLANT_TEMP, 105, 1000, "Coolant above 105 C");
+    addBand(CH_ENGINE_RPM, 4500, 100000, "Rpm above 4500");
+    addBand(CH_VEHICLE_SPEED, 120, 1000, "Speed above 120 km/h");
+    addBand(CH_ENGINE_RPM, 1, 1000, "Idle");
+}
+
+void TripStatistics::addBand(int channel, double low, double high, const QString &name)
+{
+    m_bands.push_back(Band{channel, low, high, name, 0.0});
+}
+
+void TripStatistics::setOperatingAxis(int channel, double minimum, double maximum)
+{
+    // The scan view sets its axis each time it opens; the same axis keeps
+    // the cells the running trip has already filled.
+    OperatingPointMap map(32, 0, 8000, 20, minimum, maximum);
+    if(channel == m_operatingChannel && map.merge(m_operatingMap))
+        return;
+
+    m_operatingChannel = channel;
+    m_operatingMap = map;
+    m_operatingLoad = -1.0;
+    emit operatingMapChanged();
+}
+
+void TripStatistics::reset()
+{
+    m_channels.clear();
+    for(auto &band : m_bands)
+    {
+        band.seconds = 0.0;
+    }
+
+    m_operatingMap.clear();
+    m_operatingRpm = -1.0;
+    m_operatingLoad = -1.0;
+    m_operatingTimestamp = 0;
+    emit operatingMapChanged();
+}
+
+void TripStatistics::holdOperatingPoint(qint64 timestamp)
+{
+    // Like the channels, the last rpm/load pair is weighted by how long it held.
+    qint64 held = timestamp - m_operatingTimestamp;
+    if(m_operatingRpm >= 0.0 && m_operatingLoad >= 0.0 && held > 0 && held <= MAX_HOLD)
+    {
+        int cell = m_operatingMap.add(m_operatingRpm, m_operatingLoad, held / 1000.0);
+        emit operatingCellChanged(cell % m_operatingMap.columns(), cell / m_operatingMap.columns());
+    }
+    m_operatingTimestamp = timestamp;
+}
+
+void TripStatistics::startTrip(qint64 timestamp)
+{
+    reset();
+    m_start = timestamp;
+    m_end = timestamp;
+    m_running = true;
+}
+
+QString TripStatistics::finishTrip(qint64 timestamp)
+{
+    if(!m_running)
+        return QString();
+
+    m_end = timestamp;
+    m_running = false;
+
+    QDir().mkpath(m_directory);
+    QString fileName = m_directory + "/trip_" + QDateTime::fromMSecsSinceEpoch(m_start).toString("yyyyMMdd_hhmmss") + ".ini";
+    // a full disk or a read only directory, the summary says so
+    if(!save(fileName))
+    {
+        emit tripFinished(summaryText() + "\nNot saved to " + fileName);
+        return QString();
+    }
+
+    emit tripFinished(summaryText());
+    return fileName;
+}
+
+bool TripStatistics::isRunning() const
+{
+    return m_running;
+}
+
+QString TripStatistics::directory() const
+{
+    return m_directory;
+}
+
+void TripStatistics::channelUpdated(int channel, double value, qint64 timestamp)
+{
+    if(!m_running)
+        return;
+
+    m_end = std::max(m_end, timestamp);
+
+    if(channel == CH_ENGINE_RPM || channel == m_operatingChannel)
+    {
+        holdOperatingPoint(timestamp);
+        if(channel == CH_ENGINE_RPM)
+            m_operatingRpm = value;
+        else
+            m_operatingLoad = value;
+    }
+
+    ChannelStatistics &stats = m_channels[channel];
+
+    // The previous value held until now, weight it by that time.
+    qint64 held = timestamp - stats.lastTimestamp;
+    if(stats.count > 0 && held > 0 && held <= MAX_HOLD)
+    {
+        double seconds = held / 1000.0;
+        stats.digest.add(stats.lastValue, seconds);
+        stats.weightedSum.add(stats.lastValue * seconds);
+        stats.seconds += seconds;
+
+        for(auto &band : m_bands)
+        {
+            if(band.channel == channel && stats.lastValue >= band.low && stats.lastValue < band.high)
+                band.seconds += seconds;
+        }
+    }
+
+    if(stats.count == 0)
+    {
+        stats.min = value;
+        stats.max = value;
+    }
+    else
+    {
+        stats.min = std::min(stats.min, value);
+        stats.max = std::max(stats.max, value);
+    }
+
+    stats.count++;
+    stats.lastValue = value;
+    stats.lastTimestamp = timestamp;
+}
+
+void TripStatistics::merge(const TripStatistics &other)
+{
+    for(const auto &entry : other.m_channels)
+    {
+        const ChannelStatistics &source = entry.second;
+        if(source.count == 0)
+            continue;
+
+        ChannelStatistics &stats = m_channels[entry.first];
+        if(stats.count == 0)
+        {
+            stats.min = source.min;
+            stats.max = source.max;
+        }
+        else
+        {
+            stats.min = std::min(stats.min, source.min);
+            stats.max = std::max(stats.max, source.max);
+        }
+
+        stats.count += source.count;
+        stats.weightedSum.add(source.weightedSum.value());
+        stats.seconds += source.seconds;
+        stats.digest.merge(source.digest);
+    }
+
+    for(const auto &band : other.m_bands)
+    {
+        auto it = std::find_if(m_bands.begin(), m_bands.end(), [&band](const Band &own) { return own.name == band.name; });
+        if(it != m_bands.end())
+            it->seconds += band.seconds;
+        else
+            m_bands.push_back(band);
+    }
+
+    m_operatingMap.merge(other.m_operatingMap);
+    emit operatingMapChanged();
+
+    if(m_start == 0 || (other.m_start != 0 && other.m_start < m_start))
+        m_start = other.m_start;
+    m_end = std::max(m_end, other.m_end);
+}
+
+bool TripStatistics::save(const QString &fileName) const
+{
+    QSettings settings(fileName, QSettings::IniFormat);
+
+    settings.beginGroup("Trip");
+    settings.setValue("Start", QString::number(m_start));
+    settings.setValue("End", QString::number(m_end));
+    settings.endGroup();
+
+    for(const auto &entry : m_channels)
+    {
+        const ChannelStatistics &stats = entry.second;
+        if(stats.count == 0)
+            continue;
+
+        settings.beginGroup(QString("Channel_%1").arg(entry.first));
+        settings.setValue("Name", channelName(entry.first));
+        settings.setValue("Count", QString::number(stats.count));
+        settings.setValue("Min", QString::number(stats.min));
+        settings.setValue("Max", QString::number(stats.max));
+        settings.setValue("Mean", QString::number(stats.mean()));
+        settings.setValue("P50", QString::number(stats.digest.quantile(0.50)));
+        settings.setValue("P95", QString::number(stats.digest.quantile(0.95)));
+        settings.setValue("Seconds", QString::number(stats.seconds));
+        settings.setValue("Digest", stats.digest.serialize());
+        settings.endGroup();
+    }
+
+    settings.setValue("OperatingMap/Channel", QString::number(m_operatingChannel));
+    settings.setValue("OperatingMap/Cells", m_operatingMap.serialize());
+
+    settings.beginGroup("Bands");
+    for(const auto &band : m_bands)
+    {
+        settings.setValue(band.name, QString("%1,%2,%3,%4").arg(band.channel).arg(band.low).arg(band.high).arg(band.seconds));
+    }
+    settings.endGroup();
+
+    settings.sync();
+    return settings.status() == QSettings::NoError;
+}
+
+bool TripStatistics::load(const QString &fileName)
+{
+    if(!QFile(fileName).exists())
+        return false;
+
+    QSettings settings(fileName, QSettings::IniFormat);
+    reset();
+    m_bands.clear();
+
+    m_start = settings.value("Trip/Start", "0").toString().toLongLong();
+    m_end = settings.value("Trip/End", "0").toString().toLongLong();
+
+    for(const auto &group : settings.childGroups())
+    {
+        if(!group.startsWith("Channel_"))
+            continue;
+
+        settings.beginGroup(group);
+        ChannelStatistics &stats = m_channels[group.mid(8).toInt()];
+        stats.count = settings.value("Count", "0").toString().toULongLong();
+        stats.min = settings.value("Min", "0").toString().toDouble();
+        stats.max = settings.value("Max", "0").toString().toDouble();
+        stats.seconds = settings.value("Seconds", "0").toString().toDouble();
+        stats.weightedSum.add(settings.value("Mean", "0").toString().toDouble() * stats.seconds);
+        stats.digest = TDigest::deserialize(settings.value("Digest", "").toString());
+        settings.endGroup();
+    }
+
+    m_operatingChannel = settings.value("OperatingMap/Channel", QString::number(CH_ENGINE_LOAD)).toString().toInt();
+    m_operatingMap = OperatingPointMap::deserialize(settings.value("OperatingMap/Cells", "").toString());
+    emit operatingMapChanged();
+
+    settings.beginGroup("Bands");
+    for(const auto &name : settings.childKeys())
+    {
+        auto fields = settings.value(name).toString().split(",");
+        if(fields.size() == 4)
+            m_bands.push_back(Band{fields[0].toInt(), fields[1].toDouble(), fields[2].toDouble(), name, fields[3].toDouble()});
+    }
+    settings.endGroup();
+
+    m_running = false;
+    return true;
+}
+
+QString TripStatistics::summaryText() const
+{
+    QString summary = "Trip " + QDateTime::fromMSecsSinceEpoch(m_start).toString("yyyy-MM-dd hh:mm") +
+            ", " + QString::number((m_end - m_start) / 60000.0, 'f', 1) + " min";
+
+    for(const auto &entry : m_channels)
+    {
+        const ChannelStatistics &stats = entry.second;
+        if(stats.count == 0 || stats.digest.isEmpty())
+            continue;
+
+        summary.append("\n" + channelName(entry.first) +
+                       ": min " + QString::number(stats.min, 'f', 1) +
+                       " max " + QString::number(stats.max, 'f', 1) +
+                       " mean " + QString::number(stats.mean(), 'f', 1) +
+                       " p95 " + QString::number(stats.digest.quantile(0.95), 'f', 1));
+    }
+
+    for(const auto &band : m_bands)
+    {
+        if(band.seconds > 0.0)
+            summary.append("\n" + band.name + ": " + QString::number(band.seconds, 'f', 0) + " s");
+    }
+    return summary;
+}
+
+const std::map<int, TripStatistics::ChannelStatistics> &TripStatistics::channels() const
+{
+    return m_channels;
+}
+
+const std::vector<TripStatistics::Band> &TripStatistics::bands() const
+{
+    return m_bands;
+}
+
+const OperatingPointMap &TripStatistics::operatingMap() const
+{
+    return m_operatingMap;
+}
@@ -0,0 +1,94 @@
+#ifndef TRIPSTATISTICS_H
+#define TRIPSTATISTICS_H
+
+#include <QObject>
+#include <map>
+#include "global.h"
+#include "tdigest.h"
+#include "fuelconsumption.h"
+#include "operatingpointmap.h"
+
+// Online per-channel statistics of the current trip, fed from the decode path.
+// Values are weighted by how long they were held, so an irregular poll
+// rate does not skew the mean, the percentiles or the time in band.
+class TripStatistics : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Band
+    {
+        int channel;
+        double low;
+        double high;
+        QString name;
+        double seconds;
+    };
+
+    struct ChannelStatistics
+    {
+        quint64 count{0};
+        double min{0.0};
+        double max{0.0};
+        CompensatedSum weightedSum{};
+        double seconds{0.0};
+        TDigest digest{};
+
+        qint64 lastTimestamp{0};
+        double lastValue{0.0};
+
+        double mean() const;
+    };
+
+    explicit TripStatistics(QObject *parent = nullptr);
+    static TripStatistics* getInstance();
+
+    void addBand(int channel, double low, double high, const QString &name);
+    // y axis of the operating point map, engine load by default
+    void setOperatingAxis(int channel, double minimum, double maximum);
+
+    void startTrip(qint64 timestamp);
+    // Closes the trip and writes its summary; returns the summary file,
+    // empty when it could not be written.
+    QString finishTrip(qint64 timestamp);
+    bool isRunning() const;
+    QString directory() const;
+
+    void merge(const TripStatistics &other);
+    bool save(const QString &fileName) const;
+    bool load(const QString &fileName);
+
+    QString summaryText() const;
+    const std::map<int, ChannelStatistics> &channels() const;
+    const std::vector<Band> &bands() const;
+    const OperatingPointMap &operatingMap() const;
+
+signals:
+    void tripFinished(QString summary);
+    void operatingCellChanged(int column, int row);
+    void operatingMapChanged();
+
+public slots:
+    void channelUpdated(int channel, double value, qint64 timestamp);
+
+private:
+    void reset();
+    void holdOperatingPoint(qint64 timestamp);
+
+    std::map<int, ChannelStatistics> m_channels{};
+    std::vector<Band> m_bands{};
+    qint64 m_start{0};
+    qint64 m_end{0};
+    bool m_running{false};
+    QString m_directory{};
+
+    OperatingPointMap m_operatingMap{};
+    int m_operatingChannel{CH_ENGINE_LOAD};
+    double m_operatingRpm{-1.0};
+    double m_operatingLoad{-1.0};
+    qint64 m_operatingTimestamp{0};
+
+    static TripStatistics* theInstance_;
+};
+
+#endif // TRIPSTATISTICS_H
@@ -0,0 +1,137 @@
+#include "vehicleprofile.h"
+
+VehicleProfile::VehicleProfile()
+{
+}
+
+void VehicleProfile::open(const QString &key)
+{
+    close();
+
+    QString name = key;
+    name.replace(QRegExp("[^A-Za-z0-9]"), "_");
+
+    QString directory = QDir::currentPath() + "/profiles";
+    QDir().mkpath(directory);
+
+    m_key = key;
+    m_sProfileFile = directory + "/" + name + ".ini";
+    if (QFile(m_sProfileFile).exists())
+        loadProfile();
+}
+
+QString VehicleProfile::key() const
+{
+    return m_key;
+}
+
+void VehicleProfile::close()
+{
+    m_sProfileFile.clear();
+    m_key.clear();
+    LastVehicle.clear();
+    AdapterVersion.clear();
+    AdapterDescription.clear();
+    Protocol.clear();
+    ResponseCounts.clear();
+}
+
+bool VehicleProfile::isOpen() const
+{
+    return !m_sProfileFile.isEmpty();
+}
+
+QString VehicleProfile::fileName() const
+{
+    return m_sProfileFile;
+}
+
+void VehicleProfile::loadProfile()
+{
+    if(!isOpen())
+        return;
+
+    QSettings settings(m_sProfileFile, QSettings::IniFormat);
+    AdapterVersion = settings.value("AdapterVersion", "").toString();
+    AdapterDescription = settings.value("AdapterDescription", "").toString();
+    Protocol = settings.value("Protocol", "").toString();
+    LastVehicle = settings.value("LastVehicle", "").toString();
+
+    ResponseCounts.clear();
+    settings.beginGroup("ResponseCounts");
+    for(const auto &command : settings.childKeys())
+    {
+        ResponseCounts[command] = settings.value(command, "0").toString().toInt();
+    }
+    settings.endGroup();
+}
+
+void VehicleProfile::saveProfile()
+{
+    if(!isOpen())
+        return;
+
+    QSettings settings(m_sProfileFile, QSettings::IniFormat);
+    settings.setValue("AdapterVersion", AdapterVersion);
+    settings.setValue("AdapterDescription", AdapterDescription);
+    settings.setValue("Protocol", Protocol);
+    settings.setValue("LastVehicle", LastVehicle);
+
+    settings.remove("ResponseCounts");
+    settings.beginGroup("ResponseCounts");
+    for(auto it = ResponseCounts.constBegin(); it != ResponseCounts.constEnd(); ++it)
+    {
+        settings.setValue(it.key(), QString::number(it.value()));
+    }
+    settings.endGroup();
+}
+
+void VehicleProfile::setAdapterVersion(const QString &value)
+{
+    AdapterVersion = value;
+}
+
+QString VehicleProfile::getAdapterVersion() const
+{
+    return AdapterVersion;
+}
+
+void VehicleProfile::setAdapterDescription(const QString &value)
+{
+    AdapterDescription = value;
+}
+
+QString VehicleProfile::getAdapterDescription() const
+{
+    return AdapterDescription;
+}
+
+void VehicleProfile::setProtocol(const QString &value)
+{
+    Protocol = value;
+}
+
+QString VehicleProfile::getProtocol() const
+{
+    return Protocol;
+}
+
+void VehicleProfile::setLastVehicle(const QString &value)
+{
+    LastVehicle = value;
+}
+
+QString VehicleProfile::getLastVehicle() const
+{
+    return LastVehicle;
+}
+
+void VehicleProfile::setResponseCounts(const QMap<QString, int> &value)
+{
+    ResponseCounts = value;
+}
+
+QMap<QString, int> VehicleProfile::getResponseCounts() const
+{
+    return ResponseCounts;
+}
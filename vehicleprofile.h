@@ -0,0 +1,55 @@
+#ifndef VEHICLEPROFILE_H
+#define VEHICLEPROFILE_H
+
+#include <QtCore>
+#include <QSettings>
+
+// What was learned at runtime, one ini file each under profiles/. An
+// adapter profile is named by the endpoint (wifi host:port or ble
+// address) and holds the adapter facts; most wifi clones share one
+// address, so a car is named by its VIN, or by its ecus where it has none,
+// and holds the protocol and response counts.
+class VehicleProfile
+{
+public:
+    VehicleProfile();
+
+    void open(const QString &key);
+    QString key() const;
+    void close();
+    bool isOpen() const;
+    QString fileName() const;
+
+    void loadProfile();
+    void saveProfile();
+
+    void setAdapterVersion(const QString &value);
+    QString getAdapterVersion() const;
+
+    // AT@1, tells clones with the same ATI banner apart
+    void setAdapterDescription(const QString &value);
+    QString getAdapterDescription() const;
+
+    // ATDPN number without the auto prefix
+    void setProtocol(const QString &value);
+    QString getProtocol() const;
+
+    // adapter profiles: the vehicle key of the car it was last plugged into
+    void setLastVehicle(const QString &value);
+    QString getLastVehicle() const;
+
+    // Service 01 command -> number of ecus that answer it
+    void setResponseCounts(const QMap<QString, int> &value);
+    QMap<QString, int> getResponseCounts() const;
+
+private:
+    QString m_sProfileFile{};
+    QString m_key{};
+    QString AdapterVersion{};
+    QString AdapterDescription{};
+    QString Protocol{};
+    QString LastVehicle{};
+    QMap<QString, int> ResponseCounts{};
+};
+
+#endif // VEHICLEPROFILE_H
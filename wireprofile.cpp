@@ -0,0 +1,56 @@
+#include "wireprofile.h"
+#include "global.h"
+
+WireProfile::Mode WireProfile::fromName(const QString &name)
+{
+    if(name.compare("readable", Qt::CaseInsensitive) == 0)
+        return Readable;
+
+    return Compact;
+}
+
+QString WireProfile::name(Mode mode)
+{
+    return mode == Readable ? QString("readable") : QString("compact");
+}
+
+QStringList WireProfile::commands(Mode mode)
+{
+    return QStringList{ECHO_OFF, LINEFEED_OFF, mode == Readable ? SPACES_ON : SPACES_OFF, HEADERS_OFF, FORMATTING_ON};
+}
+
+void WireStatistics::reset()
+{
+    *this = WireStatistics();
+}
+
+void WireStatistics::record(const QString &request, const QByteArray &response, int count)
+{
+    // the request goes out with its \r
+    quint64 bytes = request.size() + 1 + response.size();
+
+    requests++;
+    bytesSent += request.size() + 1;
+    bytesReceived += response.size();
+
+    if(count > 0)
+    {
+        samples += count;
+        sampleBytes += bytes;
+    }
+}
+
+double WireStatistics::bytesPerSample() const
+{
+    return samples ? static_cast<double>(sampleBytes) / samples : 0.0;
+}
+
+QString WireStatistics::summary() const
+{
+    return QString("Wire: %1 requests, %2 bytes out, %3 bytes in, %4 samples, %5 bytes/sample")
+            .arg(requests)
+            .arg(bytesSent)
+            .arg(bytesReceived)
+            .arg(samples)
+            .arg(bytesPerSample(), 0, 'f', 1);
+}
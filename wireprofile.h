@@ -0,0 +1,42 @@
+#ifndef WIREPROFILE_H
+#define WIREPROFILE_H
+
+#include <QtCore>
+
+// How the adapter formats its replies. Every byte of a reply costs link
+// time, on a bluetooth spp link at a few kB/s directly sample rate, so the
+// default profile drops echo, line feeds, spaces and headers and leaves the
+// pci bytes to the adapter (CAF1). The decoders read the same hex digits
+// either way, the readable profile only keeps the spaces for the terminal.
+class WireProfile
+{
+public:
+    enum Mode
+    {
+        Compact,        // ATE0 ATL0 ATS0 ATH0 ATCAF1, "410C1AF8"
+        Readable        // as compact with ATS1, "41 0C 1A F8"
+    };
+
+    static Mode fromName(const QString &name);
+    static QString name(Mode mode);
+
+    // AT commands that shape the replies, sent by the init sequence.
+    static QStringList commands(Mode mode);
+};
+
+// Bytes on the link per decoded sample, requests and replies together.
+struct WireStatistics
+{
+    quint64 requests{0};
+    quint64 bytesSent{0};
+    quint64 bytesReceived{0};
+    quint64 samples{0};         // service 01 answers, one per ecu
+    quint64 sampleBytes{0};     // both ways, service 01 requests only
+
+    void reset();
+    void record(const QString &request, const QByteArray &response, int count);
+    double bytesPerSample() const;
+    QString summary() const;
+};
+
+#endif // WIREPROFILE_H